@@ -0,0 +1,261 @@
+// Times TextEditor syntax coloring of C++ with each tokenizer:
+//
+//   none    no tokens, only the comment and preprocessor pass all of them
+//           share, as a baseline
+//   regex   the std::regex token list the GLSL and HLSL definitions use
+//   cstyle  the C style tokenizer callback C++ used before
+//   dfa     the table driven C++ tokenizer
+//
+// The text is generated C++ (functions, comments, strings, numbers and
+// preprocessor lines) or a file. Reports the mean and best time to color
+// everything, throughput and lines per millisecond of the best run, and the
+// mean time to color again after typing a character in the middle line, as
+// JSON Lines or a table with --table.
+//
+// With --check it times nothing, colors the text with cstyle and dfa and
+// exits with 1 at the first glyph they color differently.
+//
+// usage: ColorizeBench [--table] [--check] [--lines N] [--repeat N]
+//                      [--file F] [--tokenizer none|regex|cstyle|dfa]...
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TextEditor.h"
+#include "imgui.h"
+
+namespace {
+
+const char* const TYPES[] = {"int", "unsigned", "double", "std::string",
+                             "const char*", "size_t", "bool", "auto"};
+const char* const NAMES[] = {"count", "index", "node", "edge", "layout",
+                             "buffer", "result", "offset", "width", "scale"};
+
+struct Random {
+  uint64_t state;
+  uint32_t next() {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return uint32_t(state >> 33);
+  }
+  template <typename T, size_t N>
+  const char* pick(T (&words)[N]) {
+    return words[next() % N];
+  }
+};
+
+// Roughly the mix of a source file: short functions of declarations,
+// branches, calls and literals, with comments and preprocessor lines.
+std::string GenerateSource(size_t lines) {
+  Random random{7};
+  std::ostringstream out;
+  size_t line = 0;
+  out << "#include <string>\n#include <vector>\n\n";
+  line += 3;
+  for (unsigned function = 0; line < lines; function++) {
+    out << "/* Computes the " << random.pick(NAMES) << " of function "
+        << function << ".\n   Long comments span lines. */\n";
+    out << "static " << random.pick(TYPES) << " function_" << function
+        << "(" << random.pick(TYPES) << " " << random.pick(NAMES)
+        << ", int flags) {\n";
+    line += 3;
+    unsigned statements = 4 + random.next() % 12;
+    for (unsigned s = 0; s < statements; s++) {
+      const char* name = random.pick(NAMES);
+      switch (random.next() % 6) {
+        case 0:
+          out << "  " << random.pick(TYPES) << " " << name << "_" << s
+              << " = " << random.next() % 1000 << " * 0x" << std::hex
+              << random.next() % 4096 << std::dec << "u;\n";
+          break;
+        case 1:
+          out << "  if (" << name << " > " << (random.next() % 100) / 10.0
+              << "f && flags != 0) return " << name << ";\n";
+          break;
+        case 2:
+          out << "  // Keeps the " << name << " of the last call, "
+              << "see function_" << random.next() % (function + 1) << ".\n";
+          break;
+        case 3:
+          out << "  std::printf(\"" << name << " %d\\n\", function_"
+              << random.next() % (function + 1) << "(" << name
+              << ", 'x'));\n";
+          break;
+        case 4:
+          out << "  for (int i = 0; i < " << random.next() % 64
+              << "; i++) { " << name << " += i; }\n";
+          break;
+        default:
+          out << "#if defined(" << name << "_ENABLED)\n  " << name
+              << " = -" << random.next() % 10 << ";\n#endif\n";
+          line += 2;
+          break;
+      }
+      line++;
+    }
+    out << "  return " << random.pick(NAMES) << ";\n}\n\n";
+    line += 3;
+  }
+  return out.str();
+}
+
+TextEditor::LanguageDefinition Definition(const std::string& tokenizer) {
+  auto definition = TextEditor::LanguageDefinition::CPlusPlus();
+  if (tokenizer == "none") {
+    definition.mTokenize = nullptr;
+  } else if (tokenizer == "regex") {
+    definition.mTokenize = nullptr;
+    definition.mTokenRegexStrings =
+        TextEditor::LanguageDefinition::GLSL().mTokenRegexStrings;
+  } else if (tokenizer == "cstyle") {
+    definition.mTokenize = TextEditor::LanguageDefinition::C().mTokenize;
+  }
+  return definition;
+}
+
+// Both tokenizers must color every glyph the same.
+bool CheckTokenizers(const std::string& source) {
+  TextEditor cstyle;
+  TextEditor dfa;
+  cstyle.SetLanguageDefinition(Definition("cstyle"));
+  dfa.SetLanguageDefinition(Definition("dfa"));
+  cstyle.SetText(source);
+  dfa.SetText(source);
+  cstyle.ColorizeAll();
+  dfa.ColorizeAll();
+
+  auto lines = cstyle.GetTextLines();
+  for (size_t line = 0; line < lines.size(); line++) {
+    for (size_t index = 0; index < lines[line].size(); index++) {
+      auto expected = cstyle.GetColorIndex(line, index);
+      auto actual = dfa.GetColorIndex(line, index);
+      if (expected != actual) {
+        std::fprintf(stderr,
+                     "line %zu, byte %zu: cstyle colors %d, dfa colors %d\n"
+                     "%s\n",
+                     line + 1, index + 1, int(expected), int(actual),
+                     lines[line].c_str());
+        return false;
+      }
+    }
+  }
+  std::printf("cstyle and dfa color %zu lines the same\n", lines.size());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool table = false;
+  bool check = false;
+  size_t line_count = 20000;
+  int repeat = 5;
+  std::string file;
+  std::vector<std::string> tokenizers;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--table") {
+      table = true;
+    } else if (arg == "--check") {
+      check = true;
+    } else if (arg == "--lines" && has_value) {
+      line_count = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--repeat" && has_value) {
+      repeat = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--file" && has_value) {
+      file = argv[++i];
+    } else if (arg == "--tokenizer" && has_value &&
+               (std::strcmp(argv[i + 1], "none") == 0 ||
+                std::strcmp(argv[i + 1], "regex") == 0 ||
+                std::strcmp(argv[i + 1], "cstyle") == 0 ||
+                std::strcmp(argv[i + 1], "dfa") == 0)) {
+      tokenizers.push_back(argv[++i]);
+    } else {
+      std::fprintf(stderr,
+                   "usage: ColorizeBench [--table] [--check] [--lines N] "
+                   "[--repeat N]\n"
+                   "                     "
+                   "[--file F] [--tokenizer none|regex|cstyle|dfa]...\n");
+      return 2;
+    }
+  }
+  if (tokenizers.empty()) tokenizers = {"none", "regex", "cstyle", "dfa"};
+
+  std::string source;
+  if (file.empty()) {
+    source = GenerateSource(line_count);
+  } else {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+      std::fprintf(stderr, "can not open %s\n", file.c_str());
+      return 1;
+    }
+    source.assign(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+  }
+  size_t lines = std::count(source.begin(), source.end(), '\n') + 1;
+
+  ImGui::CreateContext();
+  if (check) {
+    bool same = CheckTokenizers(source);
+    ImGui::DestroyContext();
+    return same ? 0 : 1;
+  }
+  if (table) {
+    std::printf("%zu lines, %zu bytes\n", lines, source.size());
+    std::printf("%-8s %10s %10s %10s %12s %10s\n", "tokens", "ms", "best ms",
+                "MB/s", "lines/ms", "edit ms");
+  }
+  for (const auto& tokenizer : tokenizers) {
+    TextEditor editor;
+    editor.SetLanguageDefinition(Definition(tokenizer));
+    double total_ms = 0;
+    double best_ms = 0;
+    double edit_ms = 0;
+    for (int run = 0; run < repeat; run++) {
+      editor.SetText(source);
+      auto start = std::chrono::steady_clock::now();
+      editor.ColorizeAll();
+      double run_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+      total_ms += run_ms;
+      best_ms = run == 0 ? run_ms : std::min(best_ms, run_ms);
+
+      TextEditor::Coordinates middle(int(lines / 2), 0);
+      editor.SetSelection(middle, middle);
+      editor.SetCursorPosition(middle);
+      editor.InsertText("x");
+      start = std::chrono::steady_clock::now();
+      editor.ColorizeAll();
+      edit_ms += std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    }
+    edit_ms /= repeat;
+    double ms = total_ms / repeat;
+    double mb_per_s = source.size() / 1e3 / best_ms;
+    if (table) {
+      std::printf("%-8s %10.2f %10.2f %10.1f %12.1f %10.3f\n",
+                  tokenizer.c_str(), ms, best_ms, mb_per_s, lines / best_ms,
+                  edit_ms);
+    } else {
+      std::printf(
+          "{\"tokenizer\":\"%s\",\"lines\":%zu,\"bytes\":%zu,\"ms\":%.3f,"
+          "\"best_ms\":%.3f,\"mb_per_s\":%.2f,\"edit_ms\":%.4f}\n",
+          tokenizer.c_str(), lines, source.size(), ms, best_ms, mb_per_s,
+          edit_ms);
+    }
+    std::fflush(stdout);
+  }
+  ImGui::DestroyContext();
+  return 0;
+}
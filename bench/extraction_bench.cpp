@@ -0,0 +1,276 @@
+// Times the call graph pipeline phase by phase on generated translation
+// units (see synthetic_codebase.h):
+//
+//   parse            BuildASTFromSource
+//   extract          ExtractCallGraphFromAST with the visitor
+//   extract_matcher  ExtractCallGraphFromAST with the matcher, on --matcher
+//   build_graph      GraphGui::BuildCallGraph
+//
+// Each run happens in a forked child, so peak RSS belongs to that run only.
+// Allocations count calls to operator new; LLVM's bump allocators go to
+// malloc directly and only show up in peak RSS.
+//
+// Results are JSON Lines on stdout, one object per config, run and phase,
+// or an aligned table with --table. Without any shape option the default
+// suite runs, otherwise a single "custom" config.
+//
+// usage: ExtractionBench [--table] [--repeat N] [--matcher]
+//                        [--functions N] [--fan-out N] [--depth N]
+//                        [--templates PERCENT] [--headers N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "clang_interface.h"
+#include "graph.hpp"
+#include "synthetic_codebase.h"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+enum Phase { PARSE, EXTRACT, EXTRACT_MATCHER, BUILD_GRAPH, PHASE_COUNT };
+const char* const PHASE_NAMES[PHASE_COUNT] = {"parse", "extract",
+                                              "extract_matcher", "build_graph"};
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+long PeakRSSKilobytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+struct PhaseResult {
+  bool ran;
+  double wall_ms;
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+  long peak_rss_kb;
+  long peak_rss_growth_kb;
+};
+
+// Sent through a pipe from the child, so plain data only.
+struct RunResult {
+  bool ok;
+  PhaseResult phases[PHASE_COUNT];
+  uint64_t nodes;
+  uint64_t edges;
+  uint64_t call_sites;
+};
+
+template <typename Function>
+PhaseResult MeasurePhase(Function&& function) {
+  PhaseResult result{};
+  result.ran = true;
+  uint64_t allocations_before = allocations.load();
+  uint64_t bytes_before = allocated_bytes.load();
+  long rss_before = PeakRSSKilobytes();
+  auto start = std::chrono::steady_clock::now();
+  function();
+  result.wall_ms = MillisecondsSince(start);
+  result.allocations = allocations.load() - allocations_before;
+  result.allocated_bytes = allocated_bytes.load() - bytes_before;
+  result.peak_rss_kb = PeakRSSKilobytes();
+  result.peak_rss_growth_kb = result.peak_rss_kb - rss_before;
+  return result;
+}
+
+RunResult RunInChild(const std::string& source, bool with_matcher) {
+  RunResult result{};
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return result;
+  }
+  pid_t child = fork();
+  if (child == 0) {
+    close(fds[0]);
+    using namespace clang_interface;
+    ASTUnit ast_unit;
+    result.phases[PARSE] =
+        MeasurePhase([&] { ast_unit = BuildASTFromSource(source); });
+    CallGraph call_graph;
+    if (ast_unit) {
+      result.phases[EXTRACT] = MeasurePhase([&] {
+        call_graph =
+            ExtractCallGraphFromAST(ast_unit, {}, ExtractionMethod::Visitor);
+      });
+      if (with_matcher) {
+        result.phases[EXTRACT_MATCHER] = MeasurePhase([&] {
+          ExtractCallGraphFromAST(ast_unit, {}, ExtractionMethod::Matcher);
+        });
+      }
+      bool show = true;
+      gui::GraphGui graph(nullptr, nullptr, show);
+      result.phases[BUILD_GRAPH] =
+          MeasurePhase([&] { graph.BuildCallGraph(call_graph); });
+      result.ok = !ast_unit.HasErrors();
+    }
+    result.nodes = call_graph.nodes.size();
+    result.edges = call_graph.EdgeCount();
+    result.call_sites = call_graph.call_sites.size();
+
+    ssize_t written = write(fds[1], &result, sizeof(result));
+    _exit(written == sizeof(result) ? 0 : 1);
+  }
+  close(fds[1]);
+  if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+    result.ok = false;
+  }
+  close(fds[0]);
+  waitpid(child, nullptr, 0);
+  return result;
+}
+
+void PrintJSON(const bench::SyntheticConfig& config, size_t source_bytes,
+               unsigned run, const RunResult& result) {
+  for (unsigned phase = 0; phase < PHASE_COUNT; phase++) {
+    const auto& p = result.phases[phase];
+    if (!p.ran) {
+      continue;
+    }
+    std::printf(
+        "{\"config\":\"%s\",\"functions\":%u,\"fan_out\":%u,\"depth\":%u,"
+        "\"template_percent\":%u,\"header_classes\":%u,\"source_bytes\":%zu,"
+        "\"run\":%u,\"ok\":%s,\"phase\":\"%s\",\"wall_ms\":%.3f,"
+        "\"allocations\":%llu,\"allocated_bytes\":%llu,\"peak_rss_kb\":%ld,"
+        "\"peak_rss_growth_kb\":%ld,\"nodes\":%llu,\"edges\":%llu,"
+        "\"call_sites\":%llu}\n",
+        config.name.c_str(), config.functions, config.fan_out, config.depth,
+        config.template_percent, config.header_classes, source_bytes, run,
+        result.ok ? "true" : "false", PHASE_NAMES[phase], p.wall_ms,
+        (unsigned long long)p.allocations,
+        (unsigned long long)p.allocated_bytes, p.peak_rss_kb,
+        p.peak_rss_growth_kb, (unsigned long long)result.nodes,
+        (unsigned long long)result.edges,
+        (unsigned long long)result.call_sites);
+  }
+  std::fflush(stdout);
+}
+
+void PrintTableHeader() {
+  std::printf("%-10s %4s %-16s %10s %12s %12s %12s %8s %8s %9s\n", "config",
+              "run", "phase", "wall ms", "allocations", "alloc KB",
+              "peak RSS KB", "nodes", "edges", "sites");
+}
+
+void PrintTable(const bench::SyntheticConfig& config, unsigned run,
+                const RunResult& result) {
+  for (unsigned phase = 0; phase < PHASE_COUNT; phase++) {
+    const auto& p = result.phases[phase];
+    if (!p.ran) {
+      continue;
+    }
+    std::printf("%-10s %4u %-16s %10.2f %12llu %12llu %12ld %8llu %8llu %9llu\n",
+                config.name.c_str(), run, PHASE_NAMES[phase], p.wall_ms,
+                (unsigned long long)p.allocations,
+                (unsigned long long)p.allocated_bytes / 1024, p.peak_rss_kb,
+                (unsigned long long)result.nodes,
+                (unsigned long long)result.edges,
+                (unsigned long long)result.call_sites);
+  }
+  std::fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool table = false;
+  bool with_matcher = false;
+  unsigned repeat = 1;
+  bool custom = false;
+  bench::SyntheticConfig config;
+  config.name = "custom";
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--table") {
+      table = true;
+    } else if (arg == "--matcher") {
+      with_matcher = true;
+    } else if (arg == "--repeat" && has_value) {
+      repeat = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--functions" && has_value) {
+      config.functions = std::atoi(argv[++i]);
+      custom = true;
+    } else if (arg == "--fan-out" && has_value) {
+      config.fan_out = std::atoi(argv[++i]);
+      custom = true;
+    } else if (arg == "--depth" && has_value) {
+      config.depth = std::atoi(argv[++i]);
+      custom = true;
+    } else if (arg == "--templates" && has_value) {
+      config.template_percent = std::min(100, std::atoi(argv[++i]));
+      custom = true;
+    } else if (arg == "--headers" && has_value) {
+      config.header_classes = std::atoi(argv[++i]);
+      custom = true;
+    } else {
+      std::fprintf(stderr,
+                   "usage: ExtractionBench [--table] [--repeat N] [--matcher]\n"
+                   "                       [--functions N] [--fan-out N] "
+                   "[--depth N]\n"
+                   "                       [--templates PERCENT] "
+                   "[--headers N]\n");
+      return 2;
+    }
+  }
+
+  std::vector<bench::SyntheticConfig> configs;
+  if (custom) {
+    configs.push_back(config);
+  } else {
+    configs = bench::DefaultSuite();
+  }
+
+  if (table) {
+    PrintTableHeader();
+  }
+  bool all_ok = true;
+  for (const auto& config : configs) {
+    std::string source = bench::GenerateTranslationUnit(config);
+    for (unsigned run = 0; run < repeat; run++) {
+      RunResult result = RunInChild(source, with_matcher);
+      all_ok = all_ok && result.ok;
+      if (table) {
+        PrintTable(config, run, result);
+      } else {
+        PrintJSON(config, source.size(), run, result);
+      }
+    }
+  }
+  return all_ok ? 0 : 1;
+}
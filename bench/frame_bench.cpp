@@ -0,0 +1,310 @@
+// Times GraphGui::draw frames on synthetic call graphs, without a window.
+//
+// ImGui runs with a null renderer: the font atlas is built but never
+// uploaded, and the draw data of every frame is only counted. The renderer
+// claims ImGuiBackendFlags_RendererHasVtxOffset like the OpenGL3 back-end
+// does on GL 3.2+, so large draw lists are split the same way.
+// --no-vtx-offset drops the flag, like a GL 3.0 context.
+//
+// Every graph is drawn in three states: collapsed (only main), expanded
+// (half of the call depth) and full (GraphGui::show_full_graph). Frames are
+// measured once the layered layout of the state is swapped in. Per state
+// it reports CPU time per frame, the vertex, index and draw command counts
+// of the last frame and how long the layout took and how many crossings
+// it removed, as JSON Lines or a table with --table.
+// --node-size zooms out to the given node size in pixels, to measure the
+// reduced levels of detail.
+// --force uses the force-directed layout, frames are measured once it has
+// settled and it reports its time and iterations instead.
+//
+// --check validates the draw data of every frame: each command stays in
+// its index buffer and each index, plus the command's vertex offset, stays
+// in the vertex buffer. The exit code is 1 if a frame fails.
+//
+// --idle S also runs every state for S seconds twice, the way the GUI
+// loop runs with nothing happening: a frame per 60 Hz vsync with idle mode
+// off, and one per default idle timeout (0.5 s) with it on. It reports the
+// process CPU usage of both like the Windows Toggle Menu readout, without
+// what the GL driver and the buffer swap would add.
+//
+// usage: GraphFrameBench [--table] [--frames N] [--fan-out N] [--depth N]
+//                        [--node-size PX] [--check] [--no-vtx-offset]
+//                        [--force] [--idle S] [--nodes N]...
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clang_interface.h"
+#include "graph.hpp"
+#include "imgui.h"
+#include "synthetic_codebase.h"
+
+namespace {
+
+double ThreadCPUMilliseconds() {
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+double ProcessCPUSeconds() {
+  timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+struct FrameStats {
+  std::vector<double> cpu_ms;
+  int vertices = 0;
+  int indices = 0;
+  int draw_lists = 0;
+  int draw_commands = 0;
+  int invalid_frames = 0;
+};
+
+void InitImGui(bool vtx_offset) {
+  ImGui::CreateContext();
+  ImGuiIO& io = ImGui::GetIO();
+  io.IniFilename = nullptr;
+  io.DisplaySize = ImVec2(1920, 1080);
+  io.DeltaTime = 1.0f / 60.0f;
+  io.BackendRendererName = "null";
+  if (vtx_offset) io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+  for (int key = 0; key < ImGuiKey_COUNT; key++) io.KeyMap[key] = key;
+  // Keeps hover and clicks out of the measurement.
+  io.MousePos = ImVec2(-FLT_MAX, -FLT_MAX);
+  unsigned char* pixels;
+  int width, height;
+  io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+}
+
+// What a renderer would read for every draw command, see
+// ImGui_ImplOpenGL3_RenderDrawData.
+bool ValidDrawData(const ImDrawData* draw_data) {
+  for (int i = 0; i < draw_data->CmdListsCount; i++) {
+    const ImDrawList* list = draw_data->CmdLists[i];
+    for (const ImDrawCmd& cmd : list->CmdBuffer) {
+      if (cmd.UserCallback != nullptr) continue;
+      if (cmd.IdxOffset + cmd.ElemCount > (unsigned)list->IdxBuffer.Size)
+        return false;
+      for (unsigned idx = cmd.IdxOffset; idx < cmd.IdxOffset + cmd.ElemCount;
+           idx++) {
+        if (cmd.VtxOffset + list->IdxBuffer[idx] >=
+            (unsigned)list->VtxBuffer.Size)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+void DrawFrame(gui::GraphGui& graph, bool check, FrameStats* stats) {
+  double start = ThreadCPUMilliseconds();
+  ImGui::NewFrame();
+  ImGui::SetNextWindowPos(ImVec2(0, 0));
+  ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+  graph.draw(nullptr);
+  ImGui::Render();
+  double cpu_ms = ThreadCPUMilliseconds() - start;
+  if (stats == nullptr) return;
+
+  stats->cpu_ms.push_back(cpu_ms);
+  ImDrawData* draw_data = ImGui::GetDrawData();
+  if (check && !ValidDrawData(draw_data)) stats->invalid_frames++;
+  stats->vertices = draw_data->TotalVtxCount;
+  stats->indices = draw_data->TotalIdxCount;
+  stats->draw_lists = draw_data->CmdListsCount;
+  stats->draw_commands = 0;
+  for (int i = 0; i < draw_data->CmdListsCount; i++)
+    stats->draw_commands += draw_data->CmdLists[i]->CmdBuffer.Size;
+}
+
+// Process CPU usage in percent of drawing a frame every interval seconds
+// for seconds, sleeping in between like a vsync'd swap or
+// glfwWaitEventsTimeout.
+double IdleCPUPercent(gui::GraphGui& graph, double seconds, double interval) {
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  auto end = start + std::chrono::duration<double>(seconds);
+  auto next = start;
+  double cpu_start = ProcessCPUSeconds();
+  while (next < end) {
+    DrawFrame(graph, false, nullptr);
+    next += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(interval));
+    std::this_thread::sleep_until(next);
+  }
+  double wall = std::chrono::duration<double>(Clock::now() - start).count();
+  return 100 * (ProcessCPUSeconds() - cpu_start) / wall;
+}
+
+double Percentile(std::vector<double> values, double percentile) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t index = std::min(values.size() - 1,
+                          size_t(percentile / 100 * values.size()));
+  return values[index];
+}
+
+double Mean(const std::vector<double>& values) {
+  double sum = 0;
+  for (double value : values) sum += value;
+  return values.empty() ? 0 : sum / values.size();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool table = false;
+  int frames = 20;
+  bench::SyntheticConfig config;
+  config.fan_out = 4;
+  config.depth = 8;
+  std::vector<unsigned> sizes;
+  float node_size = 0;
+  bool check = false;
+  bool vtx_offset = true;
+  bool force = false;
+  double idle_seconds = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--table") {
+      table = true;
+    } else if (arg == "--frames" && has_value) {
+      frames = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--fan-out" && has_value) {
+      config.fan_out = std::atoi(argv[++i]);
+    } else if (arg == "--depth" && has_value) {
+      config.depth = std::atoi(argv[++i]);
+    } else if (arg == "--node-size" && has_value) {
+      node_size = std::atof(argv[++i]);
+    } else if (arg == "--check") {
+      check = true;
+    } else if (arg == "--no-vtx-offset") {
+      vtx_offset = false;
+    } else if (arg == "--force") {
+      force = true;
+    } else if (arg == "--idle" && has_value) {
+      idle_seconds = std::atof(argv[++i]);
+    } else if (arg == "--nodes" && has_value) {
+      sizes.push_back(std::atoi(argv[++i]));
+    } else {
+      std::fprintf(stderr,
+                   "usage: GraphFrameBench [--table] [--frames N] "
+                   "[--fan-out N] [--depth N]\n"
+                   "                       [--node-size PX] [--check] "
+                   "[--no-vtx-offset]\n"
+                   "                       [--force] [--idle S] "
+                   "[--nodes N]...\n");
+      return 2;
+    }
+  }
+  if (sizes.empty()) sizes = {1000, 10000, 100000, 500000};
+
+  InitImGui(vtx_offset);
+  if (table) {
+    std::printf("%8s %-10s %8s %10s %10s %10s %10s %10s %8s %8s %10s %10s "
+                "%10s %6s",
+                "nodes", "state", "visible", "mean ms", "p95 ms", "max ms",
+                "vertices", "indices", "cmds", "invalid", "layout ms",
+                "crossings", "before", "iters");
+    if (idle_seconds > 0) std::printf(" %8s %8s", "vsync %", "idle %");
+    std::printf("\n");
+  }
+  int invalid_frames = 0;
+
+  for (unsigned size : sizes) {
+    config.functions = size;
+    config.name = std::to_string(size);
+    auto call_graph = bench::GenerateCallGraph(config);
+    bool show = true;
+    gui::GraphGui graph(&ImGui::GetIO(), nullptr, show);
+    graph.BuildCallGraph(call_graph);
+    if (node_size > 0) graph.set_node_size(node_size);
+    graph.set_force_layout(force);
+
+    struct State {
+      const char* name;
+      int levels;
+    };
+    const State states[] = {{"collapsed", 0},
+                            {"expanded", std::max(1, (int)config.depth / 2)},
+                            {"full", -1}};
+    for (const auto& state : states) {
+      graph.shrink_graph();
+      if (state.levels < 0)
+        graph.show_full_graph();
+      else
+        graph.expand_levels(state.levels);
+
+      // The first frame submits the layout, the second swaps it in, or the
+      // last step of the force layout.
+      DrawFrame(graph, check, nullptr);
+      graph.wait_for_layout();
+      DrawFrame(graph, check, nullptr);
+      FrameStats stats;
+      for (int frame = 0; frame < frames; frame++)
+        DrawFrame(graph, check, &stats);
+      invalid_frames += stats.invalid_frames;
+
+      size_t visible = graph.visible_node_count();
+      const auto& layout = graph.layout_stats();
+      const auto& force_stats = graph.force_stats();
+      double layout_ms =
+          force ? force_stats.milliseconds : layout.milliseconds;
+      unsigned iterations = force ? force_stats.iterations : 0;
+      double vsync_cpu = 0, idle_cpu = 0;
+      if (idle_seconds > 0) {
+        vsync_cpu = IdleCPUPercent(graph, idle_seconds, 1.0 / 60);
+        idle_cpu = IdleCPUPercent(graph, idle_seconds, 0.5);
+      }
+      if (table) {
+        std::printf(
+            "%8u %-10s %8zu %10.2f %10.2f %10.2f %10d %10d %8d %8d %10.1f "
+            "%10zu %10zu %6u",
+            size, state.name, visible, Mean(stats.cpu_ms),
+            Percentile(stats.cpu_ms, 95), Percentile(stats.cpu_ms, 100),
+            stats.vertices, stats.indices, stats.draw_commands,
+            stats.invalid_frames, layout_ms, layout.crossings,
+            layout.crossings_before, iterations);
+        if (idle_seconds > 0)
+          std::printf(" %8.2f %8.2f", vsync_cpu, idle_cpu);
+        std::printf("\n");
+      } else {
+        std::printf(
+            "{\"nodes\":%zu,\"edges\":%zu,\"state\":\"%s\",\"visible\":%zu,"
+            "\"frames\":%d,\"cpu_ms_mean\":%.3f,\"cpu_ms_p50\":%.3f,"
+            "\"cpu_ms_p95\":%.3f,\"cpu_ms_max\":%.3f,\"vertices\":%d,"
+            "\"indices\":%d,\"draw_lists\":%d,\"draw_commands\":%d,"
+            "\"invalid_frames\":%d,\"layout_ms\":%.1f,"
+            "\"reversed_edges\":%zu,\"crossings_before\":%zu,"
+            "\"crossings\":%zu,\"bends\":%zu,\"force\":%s,"
+            "\"iterations\":%u,\"converged\":%s",
+            call_graph.nodes.size(), call_graph.EdgeCount(), state.name,
+            visible, frames, Mean(stats.cpu_ms),
+            Percentile(stats.cpu_ms, 50), Percentile(stats.cpu_ms, 95),
+            Percentile(stats.cpu_ms, 100), stats.vertices, stats.indices,
+            stats.draw_lists, stats.draw_commands, stats.invalid_frames,
+            layout_ms, layout.reversed_edges, layout.crossings_before,
+            layout.crossings, layout.bends, force ? "true" : "false",
+            iterations, force_stats.converged ? "true" : "false");
+        if (idle_seconds > 0)
+          std::printf(",\"cpu_percent_vsync\":%.2f,\"cpu_percent_idle\":%.2f",
+                      vsync_cpu, idle_cpu);
+        std::printf("}\n");
+      }
+      std::fflush(stdout);
+    }
+  }
+  ImGui::DestroyContext();
+  return invalid_frames > 0 ? 1 : 0;
+}
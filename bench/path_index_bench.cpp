@@ -0,0 +1,176 @@
+// Times PathIndex::find on generated monorepo paths.
+//
+// Each query is timed twice: typed, one keystroke after the other, so a
+// keystroke only looks at the blocks the previous one matched, and fresh,
+// scanning every path. Per keystroke it reports the mean and maximum time,
+// plus the size of the front coded paths against the plain ones, as JSON
+// Lines or a table with --table.
+//
+// usage: PathIndexBench [--table] [--paths N] [--threads N] [--limit N]
+//                       [--repeat N] [--query Q]...
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "path_index.hpp"
+
+namespace {
+
+const char* const WORDS[] = {
+    "graph",   "layout",  "render",  "parser",   "index",   "cache",
+    "thread",  "pool",    "node",    "edge",     "window",  "editor",
+    "text",    "source",  "project", "build",    "driver",  "network",
+    "storage", "query",   "plan",    "exec",     "codegen", "lexer",
+    "token",   "syntax",  "tree",    "visitor",  "matcher", "symbol",
+    "table",   "file",    "stream",  "buffer",   "memory",  "alloc",
+    "util",    "common",  "core",    "base",     "test",    "bench",
+    "client",  "server",  "proto",   "service",  "handler", "config",
+    "option",  "flag",    "metric",  "trace",    "log",     "error",
+    "status",  "result",  "future",  "executor", "channel", "queue"};
+const size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+const char* const EXTENSIONS[] = {".cpp", ".h", ".cc", ".hpp", ".c"};
+
+struct Random {
+  uint64_t state;
+  uint32_t next() {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return uint32_t(state >> 33);
+  }
+  const char* word() { return WORDS[next() % WORD_COUNT]; }
+};
+
+std::string Capitalized(const char* word) {
+  std::string result = word;
+  result[0] = result[0] - 'a' + 'A';
+  return result;
+}
+
+// Directories two to six deep, a few hundred files per leaf directory at
+// most, CamelCase file names.
+std::vector<std::string> GeneratePaths(size_t count) {
+  Random random{42};
+  std::set<std::string> paths;
+  while (paths.size() < count) {
+    std::string directory;
+    unsigned depth = 2 + random.next() % 5;
+    for (unsigned level = 0; level < depth; level++) {
+      directory += random.word();
+      if (random.next() % 4 == 0)
+        directory += std::to_string(random.next() % 10);
+      directory += '/';
+    }
+    unsigned files = 1 + random.next() % 200;
+    for (unsigned file = 0; file < files && paths.size() < count; file++) {
+      std::string name = Capitalized(random.word()) +
+                         Capitalized(random.word()) +
+                         EXTENSIONS[random.next() % 5];
+      paths.insert(directory + name);
+    }
+  }
+  return {paths.begin(), paths.end()};
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool table = false;
+  size_t path_count = 1000000;
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t limit = 100;
+  int repeat = 5;
+  std::vector<std::string> queries;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--table") {
+      table = true;
+    } else if (arg == "--paths" && has_value) {
+      path_count = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && has_value) {
+      threads = std::atoi(argv[++i]);
+    } else if (arg == "--limit" && has_value) {
+      limit = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--repeat" && has_value) {
+      repeat = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--query" && has_value) {
+      queries.push_back(argv[++i]);
+    } else {
+      std::fprintf(stderr,
+                   "usage: PathIndexBench [--table] [--paths N] [--threads N] "
+                   "[--limit N]\n"
+                   "                      [--repeat N] [--query Q]...\n");
+      return 2;
+    }
+  }
+  if (queries.empty()) queries = {"graphgui", "layoutcpp", "srvqh", "zzzq"};
+
+  auto paths = GeneratePaths(path_count);
+  size_t plain_bytes = 0;
+  for (const auto& path : paths) plain_bytes += path.size();
+  gui::PathIndex index(threads);
+  auto start = std::chrono::steady_clock::now();
+  index.assign(std::move(paths));
+  double encode_ms = Milliseconds(start);
+  auto stats = index.stats();
+
+  if (table) {
+    std::printf("%zu paths, %zu plain bytes, %zu encoded, encoded in %.1f ms, "
+                "%u threads\n",
+                stats.files, plain_bytes, stats.bytes, encode_ms, threads);
+    std::printf("%-12s %-6s %10s %10s %10s %8s  %s\n", "query", "mode",
+                "key mean", "key max", "last ms", "matches", "best");
+  }
+
+  for (const auto& query : queries) {
+    for (bool typed : {true, false}) {
+      std::vector<double> keystroke_ms(query.size(), 0);
+      double max_ms = 0;
+      std::vector<gui::PathIndex::Match> matches;
+      for (int run = 0; run < repeat; run++) {
+        index.find("", limit);
+        for (size_t length = 1; length <= query.size(); length++) {
+          // A fresh search does not build on the previous keystroke.
+          if (!typed) index.find("", limit);
+          auto keystroke = std::chrono::steady_clock::now();
+          matches = index.find(query.substr(0, length), limit);
+          double ms = Milliseconds(keystroke);
+          keystroke_ms[length - 1] += ms / repeat;
+          max_ms = std::max(max_ms, ms);
+        }
+      }
+      double mean_ms = 0;
+      for (double ms : keystroke_ms) mean_ms += ms / keystroke_ms.size();
+      const char* best = matches.empty() ? "" : matches[0].path.c_str();
+      if (table) {
+        std::printf("%-12s %-6s %10.2f %10.2f %10.2f %8zu  %s\n",
+                    query.c_str(), typed ? "typed" : "fresh", mean_ms, max_ms,
+                    keystroke_ms.back(), matches.size(), best);
+      } else {
+        std::printf(
+            "{\"paths\":%zu,\"plain_bytes\":%zu,\"encoded_bytes\":%zu,"
+            "\"threads\":%u,\"query\":\"%s\",\"mode\":\"%s\","
+            "\"keystroke_ms_mean\":%.3f,\"keystroke_ms_max\":%.3f,"
+            "\"last_keystroke_ms\":%.3f,\"matches\":%zu,\"best\":\"%s\"}\n",
+            stats.files, plain_bytes, stats.bytes, threads, query.c_str(),
+            typed ? "typed" : "fresh", mean_ms, max_ms, keystroke_ms.back(),
+            matches.size(), best);
+      }
+      std::fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include "synthetic_codebase.h"
+
+#include <algorithm>
+
+namespace bench {
+
+namespace {
+
+std::string FunctionName(unsigned f) { return "f" + std::to_string(f); }
+
+// Templates are spread evenly instead of taking a block of the TU.
+bool IsTemplate(const SyntheticConfig& config, unsigned f) {
+  return (f * config.template_percent) / 100 !=
+         ((f + 1) * config.template_percent) / 100;
+}
+
+std::string Call(const SyntheticConfig& config, unsigned callee) {
+  if (IsTemplate(config, callee)) {
+    // Both instantiations get called, so both show up in the graph.
+    return "  " + FunctionName(callee) + "<int>(1);\n  " +
+           FunctionName(callee) + "<double>(1.0);\n";
+  }
+  return "  " + FunctionName(callee) + "();\n";
+}
+
+struct Layers {
+  unsigned functions;
+  unsigned per_layer;
+  unsigned first_layer_size;
+
+  explicit Layers(const SyntheticConfig& config)
+      : functions(std::max(1u, config.functions)) {
+    unsigned depth = std::max(1u, std::min(config.depth, functions));
+    per_layer = (functions + depth - 1) / depth;
+    first_layer_size = std::min(per_layer, functions);
+  }
+
+  template <typename Function>
+  void ForEachCallee(unsigned f, unsigned fan_out, Function&& function) const {
+    unsigned next_layer = (f / per_layer + 1) * per_layer;
+    if (next_layer >= functions) {
+      return;
+    }
+    unsigned next_layer_size = std::min(per_layer, functions - next_layer);
+    for (unsigned c = 0; c < fan_out; c++) {
+      // Spread over the whole next layer, so node lookups can not get
+      // lucky by always hitting the most recently inserted node.
+      function(next_layer + (f * 7919u + c * 104729u) % next_layer_size);
+    }
+  }
+};
+
+void GenerateHeader(const SyntheticConfig& config, std::string& source) {
+  for (unsigned c = 0; c < config.header_classes; c++) {
+    std::string name = "Header" + std::to_string(c);
+    source += "struct " + name + " {\n";
+    source += "  int value = 0;\n";
+    source += "  int get() const { return value; }\n";
+    source += "  void set(int v) { value = v; check(); }\n";
+    source += "  void check() const { if (get() < 0) reset(); }\n";
+    source += "  void reset() const {}\n";
+    source += "};\n";
+  }
+}
+
+}  // namespace
+
+std::string GenerateTranslationUnit(const SyntheticConfig& config) {
+  std::string source;
+  source.reserve(config.functions * (48 + config.fan_out * 24) +
+                 config.header_classes * 200);
+  GenerateHeader(config, source);
+
+  Layers layers(config);
+  for (unsigned f = 0; f < layers.functions; f++) {
+    if (IsTemplate(config, f)) {
+      source += "template <typename T> T " + FunctionName(f) + "(T x);\n";
+    } else {
+      source += "void " + FunctionName(f) + "();\n";
+    }
+  }
+  for (unsigned f = 0; f < layers.functions; f++) {
+    if (IsTemplate(config, f)) {
+      source += "template <typename T> T " + FunctionName(f) + "(T x) {\n";
+    } else {
+      source += "void " + FunctionName(f) + "() {\n";
+    }
+    layers.ForEachCallee(f, config.fan_out, [&](unsigned callee) {
+      source += Call(config, callee);
+    });
+    source += IsTemplate(config, f) ? "  return x;\n}\n" : "}\n";
+  }
+  source += "int main() {\n";
+  for (unsigned f = 0; f < layers.first_layer_size; f++) {
+    source += Call(config, f);
+  }
+  source += "  return 0;\n}\n";
+  return source;
+}
+
+clang_interface::CallGraph GenerateCallGraph(const SyntheticConfig& config) {
+  using clang_interface::FunctionDecl;
+  clang_interface::CallGraph call_graph;
+  Layers layers(config);
+  call_graph.nodes.reserve(layers.functions + 1);
+  for (unsigned f = 0; f <= layers.functions; f++) {
+    bool is_main = f == layers.functions;
+    std::string name = is_main ? "main" : FunctionName(f);
+    call_graph.nodes.emplace_back(std::make_unique<FunctionDecl>(
+        f, "c:@F@" + name + "#", name, is_main ? "int" : "void",
+        std::vector<clang_interface::ParamVarDecl>{}, "synthetic.cc", f + 1,
+        1, is_main));
+  }
+  const uint32_t file = call_graph.AddFile("synthetic.cc");
+  auto add_call = [&](unsigned caller, unsigned callee, unsigned line) {
+    AddEdge(call_graph, {call_graph.nodes[caller].get(),
+                         call_graph.nodes[callee].get(), {file, line, 3, 0}});
+  };
+  call_graph.edges.reserve(layers.functions * config.fan_out +
+                           layers.first_layer_size);
+  for (unsigned f = 0; f < layers.functions; f++) {
+    unsigned line = f + 1;
+    layers.ForEachCallee(f, config.fan_out, [&](unsigned callee) {
+      add_call(f, callee, ++line);
+    });
+  }
+  for (unsigned f = 0; f < layers.first_layer_size; f++) {
+    add_call(layers.functions, f, f + 2);
+  }
+  call_graph.BuildAdjacency();
+  return call_graph;
+}
+
+std::vector<SyntheticConfig> DefaultSuite() {
+  std::vector<SyntheticConfig> suite;
+  auto add = [&suite](const char* name, unsigned functions, unsigned fan_out,
+                      unsigned depth, unsigned template_percent,
+                      unsigned header_classes) {
+    SyntheticConfig config;
+    config.name = name;
+    config.functions = functions;
+    config.fan_out = fan_out;
+    config.depth = depth;
+    config.template_percent = template_percent;
+    config.header_classes = header_classes;
+    suite.push_back(config);
+  };
+  add("small", 200, 4, 6, 0, 0);
+  add("medium", 4000, 8, 12, 0, 0);
+  add("wide", 4000, 32, 4, 0, 0);
+  add("deep", 4000, 2, 200, 0, 0);
+  add("templates", 4000, 8, 12, 30, 0);
+  add("headers", 4000, 8, 12, 0, 4000);
+  add("large", 40000, 8, 24, 10, 2000);
+  return suite;
+}
+
+}  // namespace bench
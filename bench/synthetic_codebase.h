@@ -0,0 +1,37 @@
+#ifndef SYNTHETIC_CODEBASE_H
+#define SYNTHETIC_CODEBASE_H
+
+#include <string>
+#include <vector>
+#include "clang_interface.h"
+
+namespace bench {
+
+// Shape of a generated translation unit. Functions are split into depth
+// layers, each function calls fan_out functions of the next layer and main
+// calls the first one, so the longest call chain is depth + 1 deep.
+struct SyntheticConfig {
+  std::string name;
+  unsigned functions = 1000;
+  unsigned fan_out = 4;
+  unsigned depth = 8;
+  // Percentage of the functions that are templates, each instantiated for
+  // two types.
+  unsigned template_percent = 0;
+  // Inline classes in front of the code, standing for included headers.
+  // They are parsed and traversed but not called.
+  unsigned header_classes = 0;
+};
+
+std::string GenerateTranslationUnit(const SyntheticConfig& config);
+// Same shape built directly as a call graph, for graphs far too big to
+// parse. Templates and headers are ignored, main is the last node.
+clang_interface::CallGraph GenerateCallGraph(const SyntheticConfig& config);
+
+// Presets from a single small TU up to a large, template and header heavy
+// one.
+std::vector<SyntheticConfig> DefaultSuite();
+
+}  // namespace bench
+
+#endif  // SYNTHETIC_CODEBASE_H
@@ -68,7 +68,8 @@
 // Your renderer back-end will need to support it (most example renderer back-ends support both 16/32-bits indices).
 // Another way to allow large meshes while keeping 16-bits indices is to handle ImDrawCmd::VtxOffset in your renderer.
 // Read about ImGuiBackendFlags_RendererHasVtxOffset for details.
-//#define ImDrawIdx unsigned int
+// The call graph easily draws millions of vertices into one window, and the OpenGL3 back-end only honors VtxOffset on GL 3.2+.
+#define ImDrawIdx unsigned int
 
 //---- Override ImDrawCallback signature (will need to modify renderer back-ends accordingly)
 //struct ImDrawList;
@@ -3,6 +3,7 @@
 #include <string>
 #include <regex>
 #include <cmath>
+#include <string_view>
 
 #include "TextEditor.h"
 
@@ -12,6 +13,9 @@
 // TODO
 // - multiline comments vs single-line: latter is blocking start of a ML
 
+// Coloring time per frame once the visible lines are done.
+static const auto ColorizeBudget = std::chrono::milliseconds(2);
+
 template<class InputIt1, class InputIt2, class BinaryPredicate>
 bool equals(InputIt1 first1, InputIt1 last1,
 	InputIt2 first2, InputIt2 last2, BinaryPredicate p)
@@ -45,7 +49,7 @@ TextEditor::TextEditor()
 	, mHandleMouseInputs(true)
 	, mIgnoreImGuiChild(false)
 	, mShowWhitespaces(true)
-	, mCheckComments(true)
+	, mFirstDirtyLineState(0)
 	, mStartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
 	, mLastClick(-1.0f)
 	, mLastTextChangeTime(std::chrono::system_clock::now())
@@ -53,6 +57,7 @@ TextEditor::TextEditor()
 	SetPalette(GetDarkPalette());
 	SetLanguageDefinition(LanguageDefinition::HLSL());
 	mLines.push_back(Line());
+	mLineStates.assign(mLines.size() + 1, LineStateUnknown);
 }
 
 TextEditor::~TextEditor()
@@ -67,6 +72,19 @@ void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
 	for (auto& r : mLanguageDefinition.mTokenRegexStrings)
 		mRegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
 
+	// Keywords win over identifiers, which win over preprocessor identifiers.
+	mIdentifierColors.clear();
+	mPreprocIdentifierColors.clear();
+	for (auto& k : mLanguageDefinition.mKeywords)
+		mIdentifierColors.emplace(k, PaletteIndex::Keyword);
+	for (auto& k : mLanguageDefinition.mIdentifiers)
+		mIdentifierColors.emplace(k.first, PaletteIndex::KnownIdentifier);
+	for (auto& k : mLanguageDefinition.mPreprocIdentifiers)
+	{
+		mIdentifierColors.emplace(k.first, PaletteIndex::PreprocIdentifier);
+		mPreprocIdentifierColors.emplace(k.first, PaletteIndex::PreprocIdentifier);
+	}
+
 	Colorize();
 }
 
@@ -603,6 +621,22 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
 	assert(!mLines.empty());
 
+	// Line aStart keeps where the removed lines started, and has to be lexed
+	// from there.
+	mLineStates.erase(mLineStates.begin() + aStart + 1, mLineStates.begin() + aEnd + 1);
+	mLineStates[aStart + 1] |= LineStateDirty;
+	mFirstDirtyLineState = std::min(mFirstDirtyLineState, aStart + 1);
+
+	if (mColorRangeMin < mColorRangeMax)
+	{
+		const int removed = aEnd - aStart;
+		mColorRangeMin = mColorRangeMin >= aEnd ? mColorRangeMin - removed : std::min(mColorRangeMin, aStart);
+		mColorRangeMax = mColorRangeMax > aEnd ? mColorRangeMax - removed : std::min(mColorRangeMax, aStart + 1);
+	}
+	// Its preprocessor state may change with the new start.
+	mColorRangeMin = std::min(mColorRangeMin, aStart);
+	mColorRangeMax = std::max(mColorRangeMax, aStart + 1);
+
 	mTextChanged = true;
         mLastTextChangeTime = std::chrono::system_clock::now();
 }
@@ -634,6 +668,18 @@ void TextEditor::RemoveLine(int aIndex)
 	mLines.erase(mLines.begin() + aIndex);
 	assert(!mLines.empty());
 
+	mLineStates.erase(mLineStates.begin() + aIndex + 1);
+	mLineStates[aIndex + 1] |= LineStateDirty;
+	mFirstDirtyLineState = std::min(mFirstDirtyLineState, aIndex + 1);
+
+	if (mColorRangeMin < mColorRangeMax)
+	{
+		mColorRangeMin = mColorRangeMin > aIndex ? mColorRangeMin - 1 : mColorRangeMin;
+		mColorRangeMax = mColorRangeMax > aIndex + 1 ? mColorRangeMax - 1 : std::min(mColorRangeMax, aIndex + 1);
+	}
+	mColorRangeMin = std::min(mColorRangeMin, aIndex);
+	mColorRangeMax = std::max(mColorRangeMax, aIndex + 1);
+
 	mTextChanged = true;
         mLastTextChangeTime = std::chrono::system_clock::now();
 }
@@ -644,6 +690,20 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 
 	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
 
+	// The new line starts where the one it pushes down did.
+	const LineState state = mLineStates[aIndex];
+	mLineStates.insert(mLineStates.begin() + aIndex, state);
+	mLineStates[aIndex + 1] |= LineStateDirty;
+	mFirstDirtyLineState = std::min(mFirstDirtyLineState, aIndex + 1);
+
+	if (mColorRangeMin < mColorRangeMax)
+	{
+		if (mColorRangeMin > aIndex)
+			++mColorRangeMin;
+		if (mColorRangeMax > aIndex)
+			++mColorRangeMax;
+	}
+
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
 		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
@@ -1158,23 +1218,30 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	mWithinRender = false;
 }
 
-void TextEditor::SetText(const std::string & aText)
+void TextEditor::SetText(std::string_view aText)
 {
 	mLines.clear();
-	mLines.emplace_back(Line());
-	for (auto chr : aText)
+	// Line by line, so each line is allocated once at its final size.
+	size_t start = 0;
+	while (true)
 	{
-		if (chr == '\r')
+		auto end = aText.find('\n', start);
+		auto text = aText.substr(start, end == std::string_view::npos ? end : end - start);
+		mLines.emplace_back(Line());
+		auto& line = mLines.back();
+		line.reserve(text.size());
+		for (auto chr : text)
 		{
 			// ignore the carriage return character
+			if (chr != '\r')
+				line.emplace_back(Glyph(chr, PaletteIndex::Default));
 		}
-		else if (chr == '\n')
-			mLines.emplace_back(Line());
-		else
-		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
-		}
+		if (end == std::string_view::npos)
+			break;
+		start = end + 1;
 	}
+	mLineStates.assign(mLines.size() + 1, LineStateUnknown);
+	mFirstDirtyLineState = 0;
 
 	mTextChanged = true;
         mLastTextChangeTime = std::chrono::system_clock::now();
@@ -1207,6 +1274,8 @@ void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
 		}
 	}
+	mLineStates.assign(mLines.size() + 1, LineStateUnknown);
+	mFirstDirtyLineState = 0;
 
 	mTextChanged = true;
         mLastTextChangeTime = std::chrono::system_clock::now();
@@ -2147,7 +2216,29 @@ void TextEditor::Colorize(int aFromLine, int aLines)
 	mColorRangeMax = std::max(mColorRangeMax, toLine);
 	mColorRangeMin = std::max(0, mColorRangeMin);
 	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
-	mCheckComments = true;
+
+	// The lines after the changed ones may start in another state now.
+	const int fromState = std::max(0, aFromLine) + 1;
+	for (int i = fromState; i <= toLine && i < (int)mLineStates.size(); ++i)
+		mLineStates[i] |= LineStateDirty;
+	mFirstDirtyLineState = std::min(mFirstDirtyLineState, fromState);
+}
+
+void TextEditor::ColorizeAll()
+{
+	if (mLines.empty() || !mColorizerEnabled)
+		return;
+
+	ColorizeComments(std::numeric_limits<int>::max(), std::chrono::steady_clock::time_point::max());
+	if (mColorRangeMin < mColorRangeMax)
+		ColorizeRange(mColorRangeMin, mColorRangeMax);
+	mColorRangeMin = std::numeric_limits<int>::max();
+	mColorRangeMax = 0;
+}
+
+bool TextEditor::IsColorizing() const
+{
+	return mColorizerEnabled && (mColorRangeMin < mColorRangeMax || mFirstDirtyLineState < (int)mLineStates.size());
 }
 
 void TextEditor::ColorizeRange(int aFromLine, int aToLine)
@@ -2221,8 +2312,8 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 			else
 			{
 				const size_t token_length = token_end - token_begin;
-
-				if (token_color == PaletteIndex::Identifier)
+				auto& colors = line[first - bufferBegin].mPreprocessor ? mPreprocIdentifierColors : mIdentifierColors;
+				if (token_color == PaletteIndex::Identifier && !colors.empty())
 				{
 					id.assign(token_begin, token_end);
 
@@ -2230,20 +2321,9 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 					if (!mLanguageDefinition.mCaseSensitive)
 						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
 
-					if (!line[first - bufferBegin].mPreprocessor)
-					{
-						if (mLanguageDefinition.mKeywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
+					auto color = colors.find(id);
+					if (color != colors.end())
+						token_color = color->second;
 				}
 
 				for (size_t j = 0; j < token_length; ++j)
@@ -2260,142 +2340,237 @@ void TextEditor::ColorizeInternal()
 	if (mLines.empty() || !mColorizerEnabled)
 		return;
 
-	if (mCheckComments)
+	auto deadline = std::chrono::steady_clock::now() + ColorizeBudget;
+
+	// The lines Render() is about to draw go first, whatever the budget.
+	int visibleBegin = 0;
+	int visibleEnd = -1;
+	if (mWithinRender && mCharAdvance.y > 0)
 	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			auto& line = mLines[currentLine];
+		visibleBegin = std::min((int)mLines.size(), (int)floor(ImGui::GetScrollY() / mCharAdvance.y));
+		visibleEnd = std::min((int)mLines.size(), visibleBegin + (int)ceil(ImGui::GetWindowHeight() / mCharAdvance.y) + 1);
+	}
+
+	ColorizeComments(visibleEnd, deadline);
+
+	if (visibleBegin < visibleEnd && mColorRangeMin < visibleEnd && visibleBegin < mColorRangeMax)
+	{
+		ColorizeRange(std::max(mColorRangeMin, visibleBegin), std::min(mColorRangeMax, visibleEnd));
+		if (visibleBegin <= mColorRangeMin)
+			mColorRangeMin = std::min(mColorRangeMax, visibleEnd);
+		else if (visibleEnd >= mColorRangeMax)
+			mColorRangeMax = visibleBegin;
+	}
 
-			if (currentIndex == 0 && !concatenate)
+	// Tokens depend on the preprocessor flags, which are not lexed yet from
+	// where the comment pass stopped.
+	const int lexedEnd = std::min((int)mLines.size(), mFirstDirtyLineState - 1);
+	const int increment = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 100;
+	while (mColorRangeMin < std::min(mColorRangeMax, lexedEnd) && std::chrono::steady_clock::now() < deadline)
+	{
+		const int to = std::min({ mColorRangeMin + increment, mColorRangeMax, lexedEnd });
+		ColorizeRange(mColorRangeMin, to);
+		mColorRangeMin = to;
+	}
+
+	if (mColorRangeMin >= mColorRangeMax)
+	{
+		mColorRangeMin = std::numeric_limits<int>::max();
+		mColorRangeMax = 0;
+	}
+}
+
+void TextEditor::ColorizeComments(int aVisibleEnd, std::chrono::steady_clock::time_point aDeadline)
+{
+	auto isDirty = [](LineState aState) { return (aState & LineStateDirty) != 0; };
+
+	int line = -1;
+	int lexed = 0;
+	while (true)
+	{
+		if (line < 0)
+		{
+			auto dirty = std::find_if(mLineStates.begin() + mFirstDirtyLineState, mLineStates.end(), isDirty);
+			mFirstDirtyLineState = (int)(dirty - mLineStates.begin());
+			if (dirty == mLineStates.end())
+				return;
+			if (mFirstDirtyLineState == 0)
 			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
+				mLineStates[0] = 0;
+				continue;
 			}
+			line = mFirstDirtyLineState - 1;
+		}
 
-			concatenate = false;
+		if (line >= aVisibleEnd && (++lexed & 31) == 0 && std::chrono::steady_clock::now() >= aDeadline)
+		{
+			// Lexed first next time.
+			mLineStates[line + 1] |= LineStateDirty;
+			mFirstDirtyLineState = line + 1;
+			return;
+		}
 
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
+		const LineState state = line == 0 ? 0 : mLineStates[line];
+		mLineStates[line] = state;
+		const LineState next = LexCommentsLine(line, state);
 
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
+		++line;
+		const LineState old = mLineStates[line];
+		mLineStates[line] = next;
 
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
+		// Only comments are drawn from the flags, a changed preprocessor
+		// state changes the tokens too.
+		const bool known = old != LineStateUnknown;
+		if (line < (int)mLines.size() && (!known || ((old ^ next) & ~(LineStateDirty | LineStateComment)) != 0))
+		{
+			mColorRangeMin = std::min(mColorRangeMin, line);
+			mColorRangeMax = std::max(mColorRangeMax, line + 1);
+		}
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		if (line == (int)mLines.size() || (known && (old & ~LineStateDirty) == next))
+			line = -1;
+	}
+}
 
-				if (withinString)
-				{
-					line[currentIndex].mMultiLineComment = inComment;
+TextEditor::LineState TextEditor::LexCommentsLine(int aLine, LineState aState)
+{
+	auto& line = mLines[aLine];
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
-				}
-				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
+	auto withinString = (aState & LineStateString) != 0;
+	auto withinSingleLineComment = (aState & LineStateSingleLineComment) != 0;
+	auto withinPreproc = (aState & LineStatePreproc) != 0;
+	auto firstChar = (aState & LineStateFirstChar) != 0;	// there is no other non-whitespace characters in the line before
+	auto concatenate = (aState & LineStateConcatenate) != 0;	// '\' on the very end of the line
+	// Where the open multi-line comment started, -1 on a line before.
+	auto commentStart = (aState & LineStateComment) ? -1 : std::numeric_limits<int>::max();
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+	if (!concatenate)
+	{
+		withinSingleLineComment = false;
+		withinPreproc = false;
+		firstChar = true;
+	}
+	concatenate = false;
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	const auto preprocChar = mLanguageDefinition.mPreprocChar;
+	const auto& startStr = mLanguageDefinition.mCommentStart;
+	const auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
+	const auto& endStr = mLanguageDefinition.mCommentEnd;
+	auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+	// Writing the glyph flags could change line.size() as far as the
+	// compiler knows.
+	const int lineSize = (int)line.size();
+	auto currentIndex = 0;
+	while (currentIndex < lineSize)
+	{
+		concatenate = false;
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
+		auto& g = line[currentIndex];
+		auto c = g.mChar;
+
+		if (firstChar && c != preprocChar && !isspace(c))
+			firstChar = false;
+
+		if (currentIndex == lineSize - 1 && c == '\\')
+			concatenate = true;
+
+		bool inComment = commentStart <= currentIndex;
+
+		if (withinString)
+		{
+			line[currentIndex].mMultiLineComment = inComment;
+			line[currentIndex].mComment = false;
+
+			if (c == '\"')
+			{
+				if (currentIndex + 1 < lineSize && line[currentIndex + 1].mChar == '\"')
+				{
+					currentIndex += 1;
+					if (currentIndex < lineSize)
+					{
+						line[currentIndex].mMultiLineComment = inComment;
+						line[currentIndex].mComment = false;
 					}
 				}
-				line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
-				if (currentIndex >= (int)line.size())
+				else
+					withinString = false;
+			}
+			else if (c == '\\')
+			{
+				currentIndex += 1;
+				if (currentIndex < lineSize)
 				{
-					currentIndex = 0;
-					++currentLine;
+					line[currentIndex].mMultiLineComment = inComment;
+					line[currentIndex].mComment = false;
 				}
 			}
+		}
+		else
+		{
+			if (firstChar && c == preprocChar)
+				withinPreproc = true;
+
+			if (c == '\"')
+			{
+				withinString = true;
+				line[currentIndex].mMultiLineComment = inComment;
+				line[currentIndex].mComment = false;
+			}
 			else
 			{
-				currentIndex = 0;
-				++currentLine;
+				// Most characters are not where a delimiter starts or ends,
+				// which the first and last character tell without comparing
+				// the rest.
+				auto from = line.begin() + currentIndex;
+
+				if (singleStartStr.size() > 0 && c == singleStartStr.front() &&
+					currentIndex + singleStartStr.size() <= (size_t)lineSize &&
+					equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
+				{
+					withinSingleLineComment = true;
+				}
+				else if (!withinSingleLineComment && (startStr.empty() || c == startStr.front()) &&
+					currentIndex + startStr.size() <= (size_t)lineSize &&
+					equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+				{
+					commentStart = currentIndex;
+				}
+
+				inComment = commentStart <= currentIndex;
+
+				line[currentIndex].mMultiLineComment = inComment;
+				line[currentIndex].mComment = withinSingleLineComment;
+
+				if ((endStr.empty() || c == endStr.back()) && currentIndex + 1 >= (int)endStr.size() &&
+					equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
+				{
+					commentStart = std::numeric_limits<int>::max();
+				}
 			}
 		}
-		mCheckComments = false;
+		g.mPreprocessor = withinPreproc;
+		if (currentIndex < lineSize)
+			line[currentIndex].mPreprocessor = withinPreproc;
+		currentIndex += UTF8CharLength(c);
 	}
 
-	if (mColorRangeMin < mColorRangeMax)
+	LineState state = 0;
+	if (withinString)
+		state |= LineStateString;
+	if (commentStart != std::numeric_limits<int>::max())
+		state |= LineStateComment;
+	if (concatenate)
 	{
-		const int increment = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
-		const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
-		ColorizeRange(mColorRangeMin, to);
-		mColorRangeMin = to;
-
-		if (mColorRangeMax == mColorRangeMin)
-		{
-			mColorRangeMin = std::numeric_limits<int>::max();
-			mColorRangeMax = 0;
-		}
-		return;
+		state |= LineStateConcatenate;
+		if (withinSingleLineComment)
+			state |= LineStateSingleLineComment;
+		if (withinPreproc)
+			state |= LineStatePreproc;
+		if (firstChar)
+			state |= LineStateFirstChar;
 	}
+	return state;
 }
 
 float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
@@ -2513,14 +2688,14 @@ void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
 	if (!mRemoved.empty())
 	{
 		aEditor->DeleteRange(mRemovedStart, mRemovedEnd);
-		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 1);
+		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 2);
 	}
 
 	if (!mAdded.empty())
 	{
 		auto start = mAddedStart;
 		aEditor->InsertTextAt(start, mAdded.c_str());
-		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 1);
+		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 2);
 	}
 
 	aEditor->mState = mAfter;
@@ -2744,6 +2919,95 @@ static bool TokenizeCStylePunctuation(const char * in_begin, const char * in_end
 	return false;
 }
 
+// The C++ tokenizer. It makes the same tokens as the C style tokenizers
+// above, but picks the kind of token from its first character in a table
+// instead of trying each of them in turn.
+namespace
+{
+	enum class CppCharClass : uint8_t
+	{
+		Other,
+		Blank,
+		IdentifierStart,
+		Digit,
+		Sign,
+		Quote,
+		Apostrophe,
+		Punctuation
+	};
+
+	constexpr std::array<CppCharClass, 256> MakeCppCharClasses()
+	{
+		std::array<CppCharClass, 256> classes = {};
+		classes[' '] = classes['\t'] = CppCharClass::Blank;
+		for (int c = 'a'; c <= 'z'; ++c)
+			classes[c] = classes[c - 'a' + 'A'] = CppCharClass::IdentifierStart;
+		classes['_'] = CppCharClass::IdentifierStart;
+		for (int c = '0'; c <= '9'; ++c)
+			classes[c] = CppCharClass::Digit;
+		for (auto c : std::string_view("[]{}!%^&*()=~|<>?:/;,."))
+			classes[(uint8_t)c] = CppCharClass::Punctuation;
+		classes['+'] = classes['-'] = CppCharClass::Sign;
+		classes['"'] = CppCharClass::Quote;
+		classes['\''] = CppCharClass::Apostrophe;
+		return classes;
+	}
+
+	constexpr std::array<CppCharClass, 256> CppCharClasses = MakeCppCharClasses();
+
+	bool IsCppIdentifierChar(char aChar)
+	{
+		auto charClass = CppCharClasses[(uint8_t)aChar];
+		return charClass == CppCharClass::IdentifierStart || charClass == CppCharClass::Digit;
+	}
+
+	bool TokenizeCpp(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, TextEditor::PaletteIndex & paletteIndex)
+	{
+		while (in_begin < in_end && CppCharClasses[(uint8_t)*in_begin] == CppCharClass::Blank)
+			in_begin++;
+
+		if (in_begin == in_end)
+		{
+			out_begin = in_end;
+			out_end = in_end;
+			paletteIndex = TextEditor::PaletteIndex::Default;
+			return true;
+		}
+
+		switch (CppCharClasses[(uint8_t)*in_begin])
+		{
+		case CppCharClass::IdentifierStart:
+			out_begin = in_begin;
+			out_end = in_begin + 1;
+			while (out_end < in_end && IsCppIdentifierChar(*out_end))
+				out_end++;
+			paletteIndex = TextEditor::PaletteIndex::Identifier;
+			return true;
+		case CppCharClass::Digit:
+			paletteIndex = TextEditor::PaletteIndex::Number;
+			return TokenizeCStyleNumber(in_begin, in_end, out_begin, out_end);
+		case CppCharClass::Sign:
+			paletteIndex = TextEditor::PaletteIndex::Number;
+			if (TokenizeCStyleNumber(in_begin, in_end, out_begin, out_end))
+				return true;
+			// fall through
+		case CppCharClass::Punctuation:
+			out_begin = in_begin;
+			out_end = in_begin + 1;
+			paletteIndex = TextEditor::PaletteIndex::Punctuation;
+			return true;
+		case CppCharClass::Quote:
+			paletteIndex = TextEditor::PaletteIndex::String;
+			return TokenizeCStyleString(in_begin, in_end, out_begin, out_end);
+		case CppCharClass::Apostrophe:
+			paletteIndex = TextEditor::PaletteIndex::CharLiteral;
+			return TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end);
+		default:
+			return false;
+		}
+	}
+}
+
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus()
 {
 	static bool inited = false;
@@ -2772,32 +3036,7 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus(
 			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.mTokenize = [](const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex) -> bool
-		{
-			paletteIndex = PaletteIndex::Max;
-
-			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
-				in_begin++;
-
-			if (in_begin == in_end)
-			{
-				out_begin = in_end;
-				out_end = in_end;
-				paletteIndex = PaletteIndex::Default;
-			}
-			else if (TokenizeCStyleString(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::String;
-			else if (TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::CharLiteral;
-			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Identifier;
-			else if (TokenizeCStyleNumber(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Number;
-			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Punctuation;
-
-			return paletteIndex != PaletteIndex::Max;
-		};
+		langDef.mTokenize = TokenizeCpp;
 
 		langDef.mCommentStart = "/*";
 		langDef.mCommentEnd = "*/";
@@ -2,6 +2,7 @@
 #define TEXTEDITOR_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <array>
 #include <memory>
@@ -197,7 +198,7 @@ public:
 	void SetBreakpoints(const Breakpoints& aMarkers) { mBreakpoints = aMarkers; }
 
 	void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
-	void SetText(const std::string& aText);
+	void SetText(std::string_view aText);
 	std::string GetText() const;
 
 	void SetTextLines(const std::vector<std::string>& aLines);
@@ -275,6 +276,16 @@ public:
             auto now = std::chrono::system_clock::now();
             return std::chrono::duration_cast<std::chrono::seconds>(now - mLastTextChangeTime).count();
         }
+        // Moves with every edit, unlike IsTextChanged, which only covers the
+        // current frame.
+        auto LastTextChangeTime() const { return mLastTextChangeTime; }
+        // Colorizes the whole text now instead of a slice per frame.
+        void ColorizeAll();
+        // Coloring is still catching up with an edit, the editor wants more
+        // frames.
+        bool IsColorizing() const;
+        // The color of the glyph at aIndex bytes into aLine.
+        PaletteIndex GetColorIndex(int aLine, int aIndex) const { return mLines[aLine][aIndex].mColorIndex; }
 
 private:
 	typedef std::vector<std::pair<std::regex, PaletteIndex>> RegexList;
@@ -321,10 +332,29 @@ private:
 
 	typedef std::vector<UndoRecord> UndoBuffer;
 
+	// Comment pass lexer state at the start of a line. Outside a continued
+	// line only the string and comment bits carry over.
+	typedef uint8_t LineState;
+	enum : LineState
+	{
+		LineStateString = 1 << 0,
+		LineStateComment = 1 << 1,
+		LineStateSingleLineComment = 1 << 2,
+		LineStatePreproc = 1 << 3,
+		LineStateFirstChar = 1 << 4,
+		LineStateConcatenate = 1 << 5,
+		// The line before must be lexed again, the rest of the byte is the
+		// old state to converge with.
+		LineStateDirty = 1 << 7,
+		LineStateUnknown = 0xff,
+	};
+
 	void ProcessInputs();
 	void Colorize(int aFromLine = 0, int aCount = -1);
 	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
 	void ColorizeInternal();
+	void ColorizeComments(int aVisibleEnd, std::chrono::steady_clock::time_point aDeadline);
+	LineState LexCommentsLine(int aLine, LineState aState);
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -387,7 +417,15 @@ private:
 	LanguageDefinition mLanguageDefinition;
 	RegexList mRegexList;
 
-	bool mCheckComments;
+	// Keywords and identifiers of the language definition by color, so a
+	// token takes one lookup.
+	std::unordered_map<std::string, PaletteIndex> mIdentifierColors;
+	std::unordered_map<std::string, PaletteIndex> mPreprocIdentifierColors;
+
+	// Lexer checkpoints, the state at the start of every line and past the
+	// last one, so an edit only lexes until the state is the same again.
+	std::vector<LineState> mLineStates;
+	int mFirstDirtyLineState;
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
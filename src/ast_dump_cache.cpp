@@ -0,0 +1,105 @@
+#include "ast_dump_cache.h"
+
+namespace clang_interface {
+
+std::string DumpDecl(const clang::FunctionDecl* decl) {
+  if (!decl) {
+    return "Function not found in the AST";
+  }
+  std::string ast_dump;
+  llvm::raw_string_ostream out(ast_dump);
+  decl->dump(out);
+  out.flush();
+  return ast_dump;
+}
+
+std::string NoASTDump(unsigned, const std::string&, const std::string&) {
+  return "No AST available for this function";
+}
+
+ASTDumpCache::ASTDumpCache(size_t capacity)
+    : capacity(capacity), dumper(NoASTDump), thread([this] { Run(); }) {}
+
+ASTDumpCache::~ASTDumpCache() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake_up.notify_one();
+  thread.join();
+}
+
+void ASTDumpCache::Reset(Dumper new_dumper) {
+  std::lock_guard<std::mutex> lock(mutex);
+  dumper = std::move(new_dumper);
+  recently_used.clear();
+  entries.clear();
+  request.reset();
+  in_flight.reset();
+  epoch++;
+}
+
+ASTDumpCache::Dump ASTDumpCache::Get(const FunctionDecl& function) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto entry = entries.find(function.ID());
+  if (entry != entries.end()) {
+    recently_used.splice(recently_used.begin(), recently_used, entry->second);
+    return entry->second->second;
+  }
+  if (in_flight != function.ID()) {
+    request = Request{function.ID(), function.USR(), function.NameAsString()};
+    wake_up.notify_one();
+  }
+  return nullptr;
+}
+
+void ASTDumpCache::SetOnResult(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  on_result = std::move(callback);
+}
+
+void ASTDumpCache::Insert(unsigned id, Dump dump) {
+  recently_used.emplace_front(id, std::move(dump));
+  entries[id] = recently_used.begin();
+  while (recently_used.size() > capacity) {
+    entries.erase(recently_used.back().first);
+    recently_used.pop_back();
+  }
+}
+
+void ASTDumpCache::Run() {
+  while (true) {
+    Request current;
+    Dumper current_dumper;
+    unsigned long current_epoch;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake_up.wait(lock, [this] { return stop || request; });
+      if (stop) {
+        return;
+      }
+      current = *request;
+      request.reset();
+      in_flight = current.id;
+      current_dumper = dumper;
+      current_epoch = epoch;
+    }
+
+    auto dump = std::make_shared<const std::string>(
+        current_dumper(current.id, current.usr, current.name));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (epoch != current_epoch) {
+      continue;
+    }
+    in_flight.reset();
+    Insert(current.id, std::move(dump));
+    auto callback = on_result;
+    lock.unlock();
+    if (callback) {
+      callback();
+    }
+  }
+}
+
+};  // namespace clang_interface
@@ -0,0 +1,77 @@
+#ifndef AST_DUMP_CACHE_H
+#define AST_DUMP_CACHE_H
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include "clang_interface.h"
+
+namespace clang_interface {
+
+std::string DumpDecl(const clang::FunctionDecl* decl);
+// Dumper for graphs without any AST behind them, e.g. loaded from an index.
+std::string NoASTDump(unsigned id, const std::string& usr,
+                      const std::string& name);
+
+// Produces AST dumps of functions on demand, on its own thread, and keeps
+// the most recently used ones around. Only the latest request matters: the
+// GUI shows a single function at a time.
+class ASTDumpCache {
+ public:
+  // Runs on the cache thread with the node ID, USR and name of the
+  // function. Whoever owns the AST decides how to reach it safely, or how
+  // to get one back if it was already freed.
+  using Dumper = std::function<std::string(
+      unsigned id, const std::string& usr, const std::string& name)>;
+
+ private:
+  using Dump = std::shared_ptr<const std::string>;
+  struct Request {
+    unsigned id;
+    std::string usr;
+    std::string name;
+  };
+
+  size_t capacity;
+  std::list<std::pair<unsigned, Dump>> recently_used;
+  std::unordered_map<unsigned, decltype(recently_used)::iterator> entries;
+
+  std::mutex mutex;
+  std::condition_variable wake_up;
+  Dumper dumper;
+  std::optional<Request> request;
+  std::optional<unsigned> in_flight;
+  unsigned long epoch = 0;
+  bool stop = false;
+  std::function<void()> on_result;
+  std::thread thread;
+
+  void Run();
+  void Insert(unsigned id, Dump dump);
+
+ public:
+  explicit ASTDumpCache(size_t capacity = 64);
+  ~ASTDumpCache();
+  ASTDumpCache(const ASTDumpCache&) = delete;
+  ASTDumpCache& operator=(const ASTDumpCache&) = delete;
+
+  // Forgets every cached dump. Called whenever the call graph is replaced,
+  // since node ids then refer to a different graph.
+  void Reset(Dumper new_dumper);
+  // Returns the dump of function if it is ready, otherwise schedules it and
+  // returns nullptr.
+  Dump Get(const FunctionDecl& function);
+  // Called on the cache thread whenever a scheduled dump becomes ready.
+  void SetOnResult(std::function<void()> callback);
+};
+
+};  // namespace clang_interface
+
+#endif  // AST_DUMP_CACHE_H
@@ -3,13 +3,17 @@
 #include "clang/AST/AST.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
+#include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Tooling/Tooling.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <tuple>
+#include <unordered_map>
 
 namespace clang_interface {
 
@@ -32,6 +36,9 @@ std::ostream& operator<<(std::ostream& out, const FunctionDecl& func_decl) {
 std::ostream& operator<<(std::ostream& out, const Edge& edge) {
   DUMP(out, edge.caller->ID());
   DUMP(out, edge.callee->ID());
+  DUMP(out, edge.call_site.file);
+  DUMP(out, edge.call_site.line);
+  DUMP(out, edge.call_site.column);
   return out;
 }
 std::ostream& operator<<(std::ostream& out, const CallGraph& call_graph) {
@@ -41,9 +48,14 @@ std::ostream& operator<<(std::ostream& out, const CallGraph& call_graph) {
     out << *node << '\n';
   }
   out << "\n--EDGES--\n";
-  for (const auto& edge : call_graph.edges) {
-    out << "Edge:\n";
-    out << edge << '\n';
+  for (uint32_t caller = 0; caller < call_graph.nodes.size(); caller++) {
+    for (const auto& edge : call_graph.Callees(caller)) {
+      out << "Edge:\n";
+      DUMP(out, call_graph.nodes[caller]->ID());
+      DUMP(out, call_graph.nodes[edge.callee]->ID());
+      DUMP(out, edge.call_site_count);
+      out << '\n';
+    }
   }
   return out;
 }
@@ -52,68 +64,269 @@ void AddEdge(CallGraph& call_graph, Edge edge) {
   call_graph.edges.emplace_back(std::move(edge));
 }
 
-class CallerCalleeFinderCallback
-    : public clang::ast_matchers::MatchFinder::MatchCallback {
+uint32_t CallGraph::AddFile(const std::string& file) {
+  auto [it, inserted] = file_ids.try_emplace(file, files.size());
+  if (inserted) {
+    files.push_back(file);
+  }
+  return it->second;
+}
+
+std::vector<uint32_t> CallGraph::AddFiles(
+    const std::vector<std::string>& names) {
+  std::vector<uint32_t> indices;
+  indices.reserve(names.size());
+  for (const auto& name : names) {
+    indices.push_back(AddFile(name));
+  }
+  return indices;
+}
+
+void CallGraph::BuildAdjacency() {
+  std::unordered_map<const FunctionDecl*, uint32_t> position;
+  position.reserve(nodes.size());
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    position.emplace(nodes[i].get(), i);
+  }
+
+  struct Call {
+    uint32_t caller;
+    uint32_t callee;
+    CallSite site;
+    auto Key() const {
+      return std::tie(caller, callee, site.file, site.line, site.column,
+                      site.expansion);
+    }
+  };
+  std::vector<Call> calls;
+  calls.reserve(edges.size());
+  for (const auto& edge : edges) {
+    calls.push_back(
+        {position.at(edge.caller), position.at(edge.callee), edge.call_site});
+  }
+  EdgesList().swap(edges);
+
+  std::sort(calls.begin(), calls.end(),
+            [](const Call& a, const Call& b) { return a.Key() < b.Key(); });
+  // The same call site shows up once per template instantiation, and once
+  // per translation unit for functions defined in headers. Unknown
+  // locations can not tell two calls apart, so none of them are merged.
+  calls.erase(std::unique(calls.begin(), calls.end(),
+                          [](const Call& a, const Call& b) {
+                            return a.site.file != 0 && a.Key() == b.Key();
+                          }),
+              calls.end());
+
+  callee_offsets.assign(nodes.size() + 1, 0);
+  caller_offsets.assign(nodes.size() + 1, 0);
+  callees.clear();
+  call_sites.clear();
+  call_sites.reserve(calls.size());
+  for (size_t i = 0; i < calls.size(); i++) {
+    const auto& call = calls[i];
+    if (i == 0 || calls[i - 1].caller != call.caller ||
+        calls[i - 1].callee != call.callee) {
+      callees.push_back(
+          {call.callee, static_cast<uint32_t>(call_sites.size()), 0});
+      callee_offsets[call.caller + 1]++;
+      caller_offsets[call.callee + 1]++;
+    }
+    call_sites.push_back(call.site);
+    callees.back().call_site_count++;
+  }
+  for (size_t i = 1; i <= nodes.size(); i++) {
+    callee_offsets[i] += callee_offsets[i - 1];
+    caller_offsets[i] += caller_offsets[i - 1];
+  }
+
+  // Callers come out sorted, since the forward rows are walked in order.
+  callers.resize(callees.size());
+  std::vector<uint32_t> fill(caller_offsets.begin(), caller_offsets.end() - 1);
+  for (uint32_t caller = 0; caller < nodes.size(); caller++) {
+    for (const auto& edge : Callees(caller)) {
+      callers[fill[edge.callee]++] = caller;
+    }
+  }
+}
+
+// Turns caller/callee declaration pairs into graph nodes and edges, shared
+// by both extractors.
+class CallGraphBuilder {
  private:
   CallGraph& call_graph;
   clang::ASTContext& ast_context;
+  // Canonical declaration -> node, so a function declared in several places
+  // still maps to one node and lookups do not scan call_graph.nodes.
+  std::unordered_map<const clang::FunctionDecl*, FunctionDecl*> node_index;
+  // FileID -> index in call_graph.files. A header included twice has two
+  // FileIDs for one name.
+  std::unordered_map<unsigned, uint32_t> file_index;
+
+  FunctionDecl* GetOrAddNode(const clang::FunctionDecl* decl) {
+    auto [it, inserted] = node_index.try_emplace(decl->getCanonicalDecl());
+    if (inserted) {
+      // Prefer the definition, it is the one worth dumping and jumping to.
+      if (auto definition = decl->getDefinition()) {
+        decl = definition;
+      }
+      call_graph.nodes.emplace_back(std::make_unique<FunctionDecl>(
+          decl, ast_context.getFullLoc(decl->getBeginLoc())));
+      it->second = call_graph.nodes.back().get();
+    }
+    return it->second;
+  }
+
+  // Walks from the call up to the file, hashing at every level where the
+  // macro spells the call and where that macro is expanded. Stable across
+  // translation units, since only file offsets go in.
+  uint32_t ExpansionHash(clang::SourceLocation loc) {
+    const auto& source_manager = ast_context.getSourceManager();
+    auto offset = [&](clang::SourceLocation at) {
+      return source_manager.getFileOffset(source_manager.getSpellingLoc(at));
+    };
+    uint32_t hash = 0;
+    while (loc.isMacroID()) {
+      hash = hash * 31 + offset(loc) + 1;
+      hash = hash * 31 +
+             offset(source_manager.getImmediateExpansionRange(loc).getBegin());
+      loc = source_manager.getImmediateMacroCallerLoc(loc);
+    }
+    return hash;
+  }
+
+  uint32_t GetOrAddFile(clang::FullSourceLoc loc) {
+    auto [it, inserted] =
+        file_index.try_emplace(loc.getFileID().getHashValue());
+    if (inserted) {
+      it->second =
+          call_graph.AddFile(loc.getManager().getFilename(loc).str());
+    }
+    return it->second;
+  }
+
+ public:
+  CallGraphBuilder(CallGraph& cg, clang::ASTContext& ast_context)
+      : call_graph(cg), ast_context(ast_context) {}
+
+  void AddCall(const clang::FunctionDecl* caller_decl,
+               const clang::CallExpr* call_expr) {
+    auto callee_decl = call_expr->getDirectCallee();
+    if (callee_decl == nullptr) {
+      return;
+    }
+    // Where the call is spelled when it is a macro argument, otherwise
+    // where the macro expands, so the location is always in a real file.
+    auto begin_loc = call_expr->getBeginLoc();
+    auto call_loc = ast_context.getFullLoc(begin_loc).getFileLoc();
+    CallSite call_site{0, 0, 0, 0};
+    if (call_loc.isValid()) {
+      call_site = {GetOrAddFile(call_loc), call_loc.getLineNumber(),
+                   call_loc.getColumnNumber(), ExpansionHash(begin_loc)};
+    }
+    AddEdge(call_graph, {GetOrAddNode(caller_decl), GetOrAddNode(callee_decl),
+                         call_site});
+  }
+};
+
+class CallerCalleeFinderCallback
+    : public clang::ast_matchers::MatchFinder::MatchCallback {
+ private:
+  CallGraphBuilder& builder;
+  const std::function<bool()>& is_cancelled;
+
  public:
-  CallerCalleeFinderCallback(clang_interface::CallGraph& cg, clang::ASTContext& ast_context) : call_graph(cg), ast_context(ast_context) {}
+  CallerCalleeFinderCallback(CallGraphBuilder& builder, const std::function<bool()>& is_cancelled) : builder(builder), is_cancelled(is_cancelled) {}
   virtual void run(
       const clang::ast_matchers::MatchFinder::MatchResult& Results) {
+    if (is_cancelled && is_cancelled()) {
+      return;
+    }
     auto caller_decl = Results.Nodes.getNodeAs<clang::FunctionDecl>("caller");
     auto callee_call_expr_decl =
         Results.Nodes.getNodeAs<clang::CallExpr>("callee");
     if (!caller_decl || !callee_call_expr_decl) {
       return;
     }
-    auto callee_decl = callee_call_expr_decl->getDirectCallee();
-    if (callee_decl == nullptr) {
-      return;
-    }
-    auto existing_caller_node = std::find_if(
-        begin(call_graph.nodes), end(call_graph.nodes),
-        [id = caller_decl->getID()](const auto& n) { return n->ID() == id; });
+    builder.AddCall(caller_decl, callee_call_expr_decl);
+  }
 
-    FunctionDecl* new_caller_node;
-    if (existing_caller_node == end(call_graph.nodes)) {
-      call_graph.nodes.emplace_back(
-          std::make_unique<clang_interface::FunctionDecl>(caller_decl, ast_context.getFullLoc(caller_decl->getBeginLoc())));
-      new_caller_node = call_graph.nodes.back().get();
-    } else {
-      new_caller_node = existing_caller_node->get();
-    }
+};  // CallerCalleeCallBack
 
-    auto existing_callee_node = std::find_if(
-        begin(call_graph.nodes), end(call_graph.nodes),
-        [id = callee_decl->getID()](const auto& n) { return n->ID() == id; });
+// Single top-down traversal that remembers the enclosing functions on a
+// stack, instead of asking the parent map for every call expression.
+class CallerCalleeVisitor
+    : public clang::RecursiveASTVisitor<CallerCalleeVisitor> {
+ private:
+  using Base = clang::RecursiveASTVisitor<CallerCalleeVisitor>;
 
-    FunctionDecl* new_callee_node;
-    if (existing_callee_node == end(call_graph.nodes)) {
-      call_graph.nodes.emplace_back(
-          std::make_unique<clang_interface::FunctionDecl>(callee_decl, ast_context.getFullLoc(callee_decl->getBeginLoc())));
-      new_callee_node = call_graph.nodes.back().get();
-    } else {
-      new_callee_node = existing_callee_node->get();
-    }
+  CallGraphBuilder& builder;
+  const std::function<bool()>& is_cancelled;
+  std::vector<const clang::FunctionDecl*> enclosing_functions;
+
+ public:
+  CallerCalleeVisitor(CallGraphBuilder& builder,
+                      const std::function<bool()>& is_cancelled)
+      : builder(builder), is_cancelled(is_cancelled) {}
+
+  // Same coverage as MatchFinder.
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
 
-    AddEdge(call_graph, {new_caller_node, new_callee_node});
+  bool TraverseDecl(clang::Decl* decl) {
+    auto function = llvm::dyn_cast_or_null<clang::FunctionDecl>(decl);
+    if (function) {
+      enclosing_functions.push_back(function);
+    }
+    bool keep_going = Base::TraverseDecl(decl);
+    if (function) {
+      enclosing_functions.pop_back();
+    }
+    return keep_going;
   }
 
-};  // CallerCalleeCallBack
+  bool VisitCallExpr(clang::CallExpr* call_expr) {
+    // Unlike the matcher, the traversal can really be stopped.
+    if (is_cancelled && is_cancelled()) {
+      return false;
+    }
+    if (!enclosing_functions.empty()) {
+      builder.AddCall(enclosing_functions.back(), call_expr);
+    }
+    return true;
+  }
+};
 
-ASTUnit BuildASTFromSource(const std::string& source,
-                           std::vector<std::string> compiler_args) {
+void AddDefaultCompilerArgs(std::vector<std::string>& compiler_args) {
   compiler_args.push_back("-std=c++17");
   compiler_args.push_back("-nostdinc++");
   compiler_args.push_back("-v");
+}
+
+ASTUnit BuildASTFromSource(const std::string& source,
+                           std::vector<std::string> compiler_args) {
+  AddDefaultCompilerArgs(compiler_args);
   ASTUnit ast(clang::tooling::buildASTFromCodeWithArgs(source, compiler_args));
   return ast;
 }
 
 clang_interface::CallGraph ExtractCallGraphFromAST(ASTUnit& ast) {
+  return ExtractCallGraphFromAST(ast, {});
+}
+
+clang_interface::CallGraph ExtractCallGraphFromAST(
+    ASTUnit& ast, const std::function<bool()>& is_cancelled,
+    ExtractionMethod method) {
   CallGraph call_graph;
-  clang_interface::CallerCalleeFinderCallback Callback(call_graph, ast.ASTContext());
+  CallGraphBuilder builder(call_graph, ast.ASTContext());
+
+  if (method == ExtractionMethod::Visitor) {
+    CallerCalleeVisitor visitor(builder, is_cancelled);
+    visitor.TraverseDecl(ast.ASTContext().getTranslationUnitDecl());
+    call_graph.BuildAdjacency();
+    return call_graph;
+  }
+
+  clang_interface::CallerCalleeFinderCallback Callback(builder, is_cancelled);
   clang::ast_matchers::MatchFinder Finder;
 
   using clang::ast_matchers::callExpr;
@@ -125,9 +338,54 @@ clang_interface::CallGraph ExtractCallGraphFromAST(ASTUnit& ast) {
       &Callback);
 
   Finder.matchAST(ast.ASTContext());
+  call_graph.BuildAdjacency();
   return call_graph;
 }
 
+class FunctionByUSRFinder
+    : public clang::RecursiveASTVisitor<FunctionByUSRFinder> {
+ private:
+  const std::string& usr;
+  const std::string& name;
+
+  bool HasName(const clang::FunctionDecl* decl) const {
+    // Plain identifiers compare without building a string.
+    if (decl->getIdentifier()) {
+      return decl->getName() == name;
+    }
+    return decl->getNameAsString() == name;
+  }
+
+ public:
+  const clang::FunctionDecl* found{nullptr};
+
+  FunctionByUSRFinder(const std::string& usr, const std::string& name)
+      : usr(usr), name(name) {}
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  bool VisitFunctionDecl(clang::FunctionDecl* decl) {
+    llvm::SmallString<128> decl_usr;
+    if (!HasName(decl) ||
+        clang::index::generateUSRForDecl(decl, decl_usr) ||
+        decl_usr.str() != usr) {
+      return true;
+    }
+    found = decl->getDefinition() ? decl->getDefinition() : decl;
+    return false;
+  }
+};
+
+const clang::FunctionDecl* FindFunctionByUSR(ASTUnit& ast,
+                                             const std::string& usr,
+                                             const std::string& name) {
+  if (usr.empty()) {
+    return nullptr;
+  }
+  FunctionByUSRFinder finder(usr, name);
+  finder.TraverseDecl(ast.ASTContext().getTranslationUnitDecl());
+  return finder.found;
+}
+
 clang_interface::CallGraph ExtractCallGraphFromSource(
     const std::string& source) {
   ASTUnit ast = BuildASTFromSource(source);
@@ -1,9 +1,12 @@
 #ifndef CLANG_INTERFACE_H
 #define CLANG_INTERFACE_H
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "clang/AST/AST.h"
 #include "clang/AST/ASTContext.h"
@@ -12,6 +15,8 @@
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Tooling/Tooling.h"
 #include "clang/Basic/SourceLocation.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 
 #define DUMP(out, x) out << #x << ' ' << x << '\n'
@@ -28,69 +33,151 @@ class ASTUnit {
 
   auto& ASTContext() { return ast->getASTContext(); }
   const auto& ASTContext() const { return ast->getASTContext(); }
+  bool HasErrors() const { return ast->getDiagnostics().hasErrorOccurred(); }
+  clang::ASTUnit& Get() { return *ast; }
+  operator bool() const { return ast != nullptr; }
 };
 
+// The graph model below copies everything it needs out of clang at
+// extraction time and keeps no pointers into the AST, so the ASTUnit can be
+// freed as soon as the call graph is extracted.
+
 class ParamVarDecl {
  private:
-  const clang::ParmVarDecl* decl{nullptr};
+  unsigned id{0};
   std::string name;
   std::string type;
-  clang::FullSourceLoc full_source_loc;
  public:
   ParamVarDecl() = default;
   explicit ParamVarDecl(const clang::ParmVarDecl* p, unsigned index)
-      : decl(p),
+      : id(p->getID()),
         name(p->getNameAsString()),
-        type(decl->getOriginalType().getAsString()) {}
-  unsigned ID() const { return decl->getID(); }
+        type(p->getOriginalType().getAsString()) {}
+  // Parameter loaded from a call graph index, without an AST behind it.
+  ParamVarDecl(unsigned id, std::string name, std::string type)
+      : id(id), name(std::move(name)), type(std::move(type)) {}
+  unsigned ID() const { return id; }
   const std::string& NameAsString() const { return name; }
   const std::string& TypeAsString() const { return type; }
-  operator bool() const { return decl; }
 };
 
 class FunctionDecl {
  private:
-  const clang::FunctionDecl* decl{nullptr};
+  unsigned id{0};
+  std::string usr;
   std::string name;
   std::string return_type;
   std::vector<ParamVarDecl> params;
-  std::string ast_dump;
-  clang::FullSourceLoc full_source_loc;
+  std::string file_name;
+  unsigned line{0};
+  unsigned column{0};
+  bool is_main{false};
+  bool is_definition{false};
 
  public:
   FunctionDecl() = default;
   explicit FunctionDecl(const clang::FunctionDecl* arg, clang::FullSourceLoc source_loc)
-      : decl(arg),
+      : id(arg->getID()),
         name(arg->getNameAsString()),
         return_type(arg->getReturnType().getAsString()),
-        full_source_loc(source_loc) {
+        is_main(arg->isMain()),
+        is_definition(arg->isThisDeclarationADefinition()) {
+    if (source_loc.isValid()) {
+      auto expansion_loc = source_loc.getExpansionLoc();
+      file_name = expansion_loc.getManager().getFilename(expansion_loc).str();
+      line = expansion_loc.getLineNumber();
+      column = expansion_loc.getColumnNumber();
+    }
     unsigned i = 0;
     for (auto param = arg->param_begin(); param != arg->param_end(); ++param) {
       params.emplace_back(*param, ++i);
     }
-    llvm::raw_string_ostream out(ast_dump);
-    arg->dump(out);
-    out.str();
-
+    llvm::SmallString<128> usr_buffer;
+    if (!clang::index::generateUSRForDecl(arg, usr_buffer)) {
+      usr = usr_buffer.str().str();
+    }
   }
-  const std::string& ASTDump() const { return ast_dump; }
-  unsigned ID() const { return decl->getID(); }
+  // Function loaded from a call graph index, without an AST behind it.
+  FunctionDecl(unsigned id, std::string usr, std::string name,
+               std::string return_type, std::vector<ParamVarDecl> params,
+               std::string file_name, unsigned line, unsigned column,
+               bool is_main, bool is_definition = true)
+      : id(id),
+        usr(std::move(usr)),
+        name(std::move(name)),
+        return_type(std::move(return_type)),
+        params(std::move(params)),
+        file_name(std::move(file_name)),
+        line(line),
+        column(column),
+        is_main(is_main),
+        is_definition(is_definition) {}
+  unsigned ID() const { return id; }
+  // Decl IDs are only unique within one ASTContext; graphs merged from
+  // several translation units renumber their nodes.
+  void SetID(unsigned new_id) { id = new_id; }
+  // Unified Symbol Resolution, identical for the same function in every
+  // translation unit. Empty when clang could not generate one.
+  const std::string& USR() const { return usr; }
   const std::string& NameAsString() const { return name; }
   const std::string& ReturnTypeAsString() const { return return_type; }
 
-  const clang::FullSourceLoc& FullSourceLoc() const { return full_source_loc; }
-	
+  const std::string& FileName() const { return file_name; }
+  unsigned Line() const { return line; }
+  unsigned Column() const { return column; }
+
   auto ParamBegin() const { return params.begin(); }
   auto ParamEnd() const { return params.end(); }
 
   bool HasParams() const { return ParamBegin() != ParamEnd(); }
-  bool IsMain() const { return decl->isMain(); }
-  operator bool() const { return decl; }
+  bool IsMain() const { return is_main; }
+  // False when the translation unit it came from only declares it.
+  bool IsDefinition() const { return is_definition; }
 };
 
+// Whether the node merged for a function across translation units should
+// take over incoming instead of keeping stored. The definition wins over
+// prototypes, so jumping to and dumping the function lands on its body.
+inline bool PrefersDeclaration(const FunctionDecl& incoming,
+                               const FunctionDecl& stored) {
+  return incoming.IsDefinition() && !stored.IsDefinition();
+}
+
+// Where a call is written. file indexes CallGraph::files, in a call graph
+// index it is a string offset.
+struct CallSite {
+  uint32_t file;
+  uint32_t line;
+  uint32_t column;
+  // Every call in a macro body gets the location of the expansion, this
+  // hashes the macro spellings the call comes through to tell them apart.
+  // 0 outside of macros.
+  uint32_t expansion;
+};
+
+// One call expression, as recorded during extraction.
 struct Edge {
   clang_interface::FunctionDecl* caller;
   clang_interface::FunctionDecl* callee;
+  CallSite call_site{0, 0, 0, 0};
+};
+
+// One unique caller -> callee pair. Its call sites are
+// CallGraph::call_sites[first_call_site, first_call_site + call_site_count).
+struct CalleeEdge {
+  uint32_t callee;
+  uint32_t first_call_site;
+  uint32_t call_site_count;
+};
+
+template <typename T>
+struct Span {
+  const T* first{nullptr};
+  const T* last{nullptr};
+  const T* begin() const { return first; }
+  const T* end() const { return last; }
+  size_t size() const { return last - first; }
+  bool empty() const { return first == last; }
 };
 
 struct CallGraph {
@@ -98,7 +185,46 @@ struct CallGraph {
   using EdgesList = std::vector<Edge>;
 
   NodesList nodes;
+  // Call expressions appended by the extractors, consumed by BuildAdjacency.
   EdgesList edges;
+
+  // Compressed sparse rows indexed by position in nodes: the callees of
+  // nodes[i] are callees[callee_offsets[i], callee_offsets[i + 1]), its
+  // callers are callers[caller_offsets[i], caller_offsets[i + 1]).
+  std::vector<uint32_t> callee_offsets;
+  std::vector<CalleeEdge> callees;
+  std::vector<uint32_t> caller_offsets;
+  std::vector<uint32_t> callers;
+  std::vector<CallSite> call_sites;
+  // File names of the call sites, files[0] is the empty name of unknown
+  // locations.
+  std::vector<std::string> files{""};
+  std::unordered_map<std::string, uint32_t> file_ids{{"", 0}};
+
+  // Index of file in files, added when it is new.
+  uint32_t AddFile(const std::string& file);
+  // AddFile of every name of another graph's files, to map the file
+  // indices of call sites taken over from it.
+  std::vector<uint32_t> AddFiles(const std::vector<std::string>& names);
+
+  // Collapses edges into unique caller -> callee pairs, dropping call sites
+  // seen twice, and rebuilds the adjacency above. Calls without a known
+  // location are all kept. Clears edges.
+  void BuildAdjacency();
+
+  size_t EdgeCount() const { return callees.size(); }
+  Span<CalleeEdge> Callees(uint32_t node) const {
+    return {callees.data() + callee_offsets[node],
+            callees.data() + callee_offsets[node + 1]};
+  }
+  Span<uint32_t> Callers(uint32_t node) const {
+    return {callers.data() + caller_offsets[node],
+            callers.data() + caller_offsets[node + 1]};
+  }
+  Span<CallSite> CallSites(const CalleeEdge& edge) const {
+    return {call_sites.data() + edge.first_call_site,
+            call_sites.data() + edge.first_call_site + edge.call_site_count};
+  }
 };
 
 std::ostream& operator<<(std::ostream&, const ParamVarDecl&);
@@ -106,13 +232,32 @@ std::ostream& operator<<(std::ostream&, const FunctionDecl&);
 std::ostream& operator<<(std::ostream&, const Edge&);
 std::ostream& operator<<(std::ostream&, const CallGraph&);
 
+// Flags every AST of the editor buffer is built with.
+void AddDefaultCompilerArgs(std::vector<std::string>& compiler_args);
 ASTUnit BuildASTFromSource(const std::string& source,
                            std::vector<std::string> compiler_args = {});
 void AddEdge(CallGraph& call_graph, Edge edge);
 std::optional<clang_interface::FunctionDecl> FindNodeWithId(
     const CallGraph& call_graph, unsigned id);
+enum class ExtractionMethod {
+  // One RecursiveASTVisitor pass tracking the enclosing function.
+  Visitor,
+  // callExpr(hasAncestor(functionDecl())), builds the full parent map.
+  Matcher,
+};
 CallGraph ExtractCallGraphFromAST(ASTUnit& ast);
+// Same as above, but stops recording nodes and edges as soon as is_cancelled
+// returns true. Used by ParseWorker to abandon stale snapshots.
+CallGraph ExtractCallGraphFromAST(
+    ASTUnit& ast, const std::function<bool()>& is_cancelled,
+    ExtractionMethod method = ExtractionMethod::Visitor);
 CallGraph ExtractCallGraphFromSource(const std::string& source);
+// Looks a function up by the USR and name captured in FunctionDecl::USR()
+// and NameAsString(), returning its definition when the AST has one. Only
+// functions of that name get their USR generated.
+const clang::FunctionDecl* FindFunctionByUSR(ASTUnit& ast,
+                                             const std::string& usr,
+                                             const std::string& name);
 // CallGraph ExtractCallGraphFromFile(const std::string& file_name);
 
 };  // namespace clang_interface
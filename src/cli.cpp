@@ -0,0 +1,318 @@
+// Headless call graph extraction, for machines without a display.
+//
+// SourceExplorerCLI [-p <build dir | compile_commands.json>] [-j <threads>]
+//                   [--dot <file>] [--jsonl <file>] [--index <file>]
+//                   [-q] [files...] [-- <compiler args>]
+// SourceExplorerCLI --query <index> --usr <usr>...
+//
+// Output files may be "-" for stdout. Compiler args after "--" only apply
+// to the files given on the command line. --query prints the callers and
+// callees of the functions with the given USRs, read straight out of the
+// mapped index.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clang_interface.h"
+#include "graph_index.h"
+#include "graph_writer.h"
+#include "project_indexer.h"
+#include "thread_pool.h"
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+struct Options {
+  std::string project_path;
+  std::vector<std::string> files;
+  std::vector<std::string> compiler_args;
+  std::string dot_output;
+  std::string jsonl_output;
+  std::string index_output;
+  std::string query_index;
+  std::vector<std::string> usrs;
+  unsigned threads = std::thread::hardware_concurrency();
+  bool quiet = false;
+};
+
+void PrintUsage() {
+  std::cerr << "usage: SourceExplorerCLI [-p <build dir | "
+               "compile_commands.json>] [-j <threads>]\n"
+               "                         [--dot <file>] [--jsonl <file>] "
+               "[--index <file>]\n"
+               "                         [-q] [files...] [-- <compiler "
+               "args>]\n"
+               "       SourceExplorerCLI --query <index> --usr <usr>...\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--") {
+      options.compiler_args.assign(argv + i + 1, argv + argc);
+      break;
+    } else if (arg == "-q") {
+      options.quiet = true;
+    } else if (arg == "-p" && has_value) {
+      options.project_path = argv[++i];
+    } else if (arg == "-j" && has_value) {
+      options.threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--dot" && has_value) {
+      options.dot_output = argv[++i];
+    } else if (arg == "--jsonl" && has_value) {
+      options.jsonl_output = argv[++i];
+    } else if (arg == "--index" && has_value) {
+      options.index_output = argv[++i];
+    } else if (arg == "--query" && has_value) {
+      options.query_index = argv[++i];
+    } else if (arg == "--usr" && has_value) {
+      options.usrs.push_back(argv[++i]);
+    } else if (arg[0] == '-') {
+      std::cerr << "unknown or incomplete option " << arg << '\n';
+      return false;
+    } else {
+      options.files.push_back(arg);
+    }
+  }
+  if (!options.query_index.empty()) {
+    if (options.usrs.empty()) {
+      std::cerr << "nothing to query, give at least one --usr\n";
+      return false;
+    }
+    return true;
+  }
+  if (options.project_path.empty() && options.files.empty()) {
+    std::cerr << "nothing to do, give a compilation database or files\n";
+    return false;
+  }
+  if (options.dot_output.empty() && options.jsonl_output.empty() &&
+      options.index_output.empty()) {
+    std::cerr << "no output, give at least one of --dot, --jsonl, --index\n";
+    return false;
+  }
+  return true;
+}
+
+// Keeps a file stream alive, or points at stdout for "-".
+class Output {
+ private:
+  std::ofstream file;
+  std::ostream* stream{nullptr};
+
+ public:
+  bool Open(const std::string& path) {
+    if (path.empty()) {
+      return true;
+    }
+    if (path == "-") {
+      stream = &std::cout;
+      return true;
+    }
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      std::cerr << "can not open " << path << " for writing\n";
+      return false;
+    }
+    stream = &file;
+    return true;
+  }
+  std::ostream* Stream() { return stream; }
+  bool Failed() const { return stream && !*stream; }
+};
+
+void PrintCallSites(const clang_interface::MappedIndex& index,
+                    const clang_interface::CalleeEdge& edge) {
+  for (const auto& site : index.CallSites(edge)) {
+    std::cout << ' ' << index.String(site.file) << ':' << site.line << ':'
+              << site.column;
+  }
+  std::cout << '\n';
+}
+
+// Answers from the mapping, the graph is never loaded as a whole.
+int Query(const Options& options) {
+  using namespace clang_interface;
+  auto start = std::chrono::steady_clock::now();
+  std::string error_message;
+  auto index = MappedIndex::Open(options.query_index, error_message);
+  if (!index) {
+    std::cerr << error_message << '\n';
+    return 1;
+  }
+  double open_ms = MillisecondsSince(start);
+
+  start = std::chrono::steady_clock::now();
+  int status = 0;
+  for (const auto& usr : options.usrs) {
+    auto node = index->FindByUSR(usr);
+    if (!node) {
+      std::cerr << usr << ": not in the index\n";
+      status = 1;
+      continue;
+    }
+    auto name = [&](uint32_t n) { return index->String(index->Node(n).name); };
+    const auto& function = index->Node(*node);
+    std::cout << usr << ' ' << name(*node) << ' '
+              << index->String(function.file_name) << ':' << function.line
+              << ':' << function.column << '\n';
+    for (const auto& edge : index->Callees(*node)) {
+      std::cout << "  calls " << name(edge.callee);
+      PrintCallSites(*index, edge);
+    }
+    // Call sites live on the caller's row.
+    for (uint32_t caller : index->Callers(*node)) {
+      for (const auto& edge : index->Callees(caller)) {
+        if (edge.callee == *node) {
+          std::cout << "  called by " << name(caller);
+          PrintCallSites(*index, edge);
+        }
+      }
+    }
+  }
+  std::fprintf(stderr, "open %.2f ms, query %.2f ms\n", open_ms,
+               MillisecondsSince(start));
+  return status;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  using namespace clang_interface;
+  auto total_start = std::chrono::steady_clock::now();
+
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage();
+    return 2;
+  }
+  if (!options.query_index.empty()) {
+    return Query(options);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<clang::tooling::CompileCommand> commands;
+  if (!options.project_path.empty()) {
+    std::string error_message;
+    auto database = LoadCompilationDatabase(options.project_path, error_message);
+    if (!database) {
+      std::cerr << error_message << '\n';
+      return 1;
+    }
+    commands = database->getAllCompileCommands();
+  }
+  std::string working_directory = std::filesystem::current_path().string();
+  for (const auto& file : options.files) {
+    std::vector<std::string> command_line = {"clang++", "-std=c++17"};
+    command_line.insert(command_line.end(), options.compiler_args.begin(),
+                        options.compiler_args.end());
+    command_line.push_back(file);
+    commands.emplace_back(working_directory, file, std::move(command_line),
+                          "");
+  }
+  double load_ms = MillisecondsSince(start);
+
+  Output dot, jsonl;
+  if (!dot.Open(options.dot_output) || !jsonl.Open(options.jsonl_output)) {
+    return 1;
+  }
+  CallGraph merged;
+  StreamingGraphWriter writer(
+      dot.Stream(), jsonl.Stream(),
+      options.index_output.empty() ? nullptr : &merged);
+  writer.Begin();
+
+  // Parsing and extraction run on the pool, writing is serialized. Phase
+  // times are summed over the workers.
+  std::mutex writer_mutex;
+  double parse_ms = 0, extract_ms = 0, write_ms = 0;
+  size_t failed = 0, done = 0;
+  {
+    ThreadPool pool(options.threads);
+    for (const auto& command : commands) {
+      pool.Submit([&](unsigned) {
+        TranslationUnitReport report;
+        auto start = std::chrono::steady_clock::now();
+        ASTUnit ast_unit = BuildASTFromCommand(command, report);
+        report.parse_ms = MillisecondsSince(start);
+
+        CallGraph call_graph;
+        if (ast_unit) {
+          start = std::chrono::steady_clock::now();
+          call_graph = ExtractCallGraphFromAST(ast_unit);
+          report.extract_ms = MillisecondsSince(start);
+          report.ok = !ast_unit.HasErrors();
+          if (!report.ok) {
+            report.error = "compile errors";
+          }
+        }
+        // The AST is by far the biggest thing around, drop it before
+        // waiting for the writer.
+        ast_unit = ASTUnit();
+
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        start = std::chrono::steady_clock::now();
+        writer.Add(call_graph);
+        write_ms += MillisecondsSince(start);
+        parse_ms += report.parse_ms;
+        extract_ms += report.extract_ms;
+        done++;
+        if (!report.ok) {
+          failed++;
+          std::cerr << report.file << ": " << report.error << '\n';
+        } else if (!options.quiet) {
+          std::fprintf(stderr, "[%zu/%zu] %s (%.1f ms parse, %.1f ms extract)\n",
+                       done, commands.size(), report.file.c_str(),
+                       report.parse_ms, report.extract_ms);
+        }
+      });
+    }
+    pool.Wait();
+  }
+
+  start = std::chrono::steady_clock::now();
+  writer.End();
+  write_ms += MillisecondsSince(start);
+  if (dot.Failed() || jsonl.Failed()) {
+    std::cerr << "failed writing the output\n";
+    return 1;
+  }
+
+  double index_ms = 0;
+  if (!options.index_output.empty()) {
+    start = std::chrono::steady_clock::now();
+    std::string error_message;
+    if (!WriteIndex(merged, options.index_output, error_message)) {
+      std::cerr << error_message << '\n';
+      return 1;
+    }
+    index_ms = MillisecondsSince(start);
+  }
+
+  std::fprintf(stderr,
+               "%zu translation units (%zu failed), %u functions, %zu edges, "
+               "%zu call sites\n",
+               commands.size(), failed, writer.NodeCount(), writer.EdgeCount(),
+               writer.CallSiteCount());
+  std::fprintf(stderr,
+               "load %.1f ms, parse %.1f ms, extract %.1f ms, write %.1f ms, "
+               "index %.1f ms, total %.1f ms wall\n",
+               load_ms, parse_ms, extract_ms, write_ms, index_ms,
+               MillisecondsSince(total_start));
+  return failed == 0 ? 0 : 1;
+}
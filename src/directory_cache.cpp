@@ -0,0 +1,269 @@
+#include "directory_cache.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace gui {
+
+namespace {
+
+// How often a first scan shows what it found so far.
+const auto PUBLISH_INTERVAL = std::chrono::milliseconds(100);
+
+}  // namespace
+
+DirectoryCache::DirectoryCache(size_t capacity) : capacity(capacity) {
+#ifdef __linux__
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  // Without the pipe the scan thread could not be woken up, get() then
+  // scans on the calling thread.
+  if (pipe(wake_fds) != 0) {
+    wake_fds[0] = wake_fds[1] = -1;
+    return;
+  }
+  fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+  thread = std::thread([this] { run(); });
+}
+
+DirectoryCache::~DirectoryCache() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+    interrupt = true;
+  }
+  wake();
+  if (thread.joinable()) thread.join();
+  for (int fd : {inotify_fd, wake_fds[0], wake_fds[1]})
+    if (fd >= 0) close(fd);
+}
+
+DirectoryCache::ListingPtr DirectoryCache::get(const fs::path& directory) {
+  bool synchronous = !thread.joinable();
+  if (synchronous) read_events();
+  std::string key = directory.string();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ListingPtr listing;
+    bool needs_scan = true;
+    auto cached = listings.find(key);
+    if (cached != listings.end()) {
+      recently_used.splice(recently_used.begin(), recently_used,
+                           cached->second.recently_used);
+      listing = cached->second.listing;
+      needs_scan = cached->second.stale;
+    }
+    if (!needs_scan) return listing;
+    if (!synchronous) {
+      if (scanning != key && request != directory) {
+        request = directory;
+        interrupt = scanning.has_value();
+        wake();
+      }
+      return listing;
+    }
+  }
+  scan(directory);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto cached = listings.find(key);
+  return cached != listings.end() ? cached->second.listing : nullptr;
+}
+
+void DirectoryCache::refresh() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& [directory, cached] : listings) cached.stale = true;
+}
+
+void DirectoryCache::set_on_change(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  on_change = std::move(callback);
+}
+
+void DirectoryCache::wake() {
+  char byte = 0;
+  if (write(wake_fds[1], &byte, 1) < 0) {
+    // Full, the scan thread wakes up anyway.
+  }
+}
+
+void DirectoryCache::run() {
+  while (true) {
+    pollfd fds[2] = {{wake_fds[0], POLLIN, 0}, {inotify_fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0 && errno != EINTR) return;
+    char drain[64];
+    while (read(wake_fds[0], drain, sizeof(drain)) > 0) {
+    }
+    if (fds[1].revents & POLLIN) read_events();
+
+    fs::path directory;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stop) return;
+      if (!request) continue;
+      directory = std::move(*request);
+      request.reset();
+      scanning = directory.string();
+      interrupt = false;
+    }
+    scan(directory);
+    std::lock_guard<std::mutex> lock(mutex);
+    scanning.reset();
+  }
+}
+
+void DirectoryCache::scan(const fs::path& directory) {
+  std::string key = directory.string();
+  bool first_scan;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = listings.find(key);
+    first_scan = cached == listings.end();
+    if (!first_scan) cached->second.stale = false;
+  }
+  // Before reading, so nothing that changes meanwhile is missed.
+  watch(key);
+
+  std::vector<Entry> entries;
+  std::error_code error;
+  auto last_publish = std::chrono::steady_clock::now();
+  fs::directory_iterator it(
+      directory, fs::directory_options::skip_permission_denied, error);
+  for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+    if (interrupt) {
+      // Picked up again the next time it is asked for.
+      std::lock_guard<std::mutex> lock(mutex);
+      auto cached = listings.find(key);
+      if (cached == listings.end()) return;
+      if (cached->second.listing->complete) {
+        cached->second.stale = true;
+      } else {
+        recently_used.erase(cached->second.recently_used);
+        listings.erase(cached);
+      }
+      return;
+    }
+    // Symbolic links are followed, the rest comes with the directory entry.
+    std::error_code type_error;
+    entries.push_back({it->path(), it->path().filename().string(),
+                       it->is_directory(type_error)});
+    if (first_scan &&
+        std::chrono::steady_clock::now() - last_publish > PUBLISH_INTERVAL) {
+      publish(key, entries, false, "");
+      // From the end, sorting a long partial listing takes a while.
+      last_publish = std::chrono::steady_clock::now();
+    }
+  }
+  publish(key, std::move(entries), true, error ? error.message() : "");
+}
+
+void DirectoryCache::publish(const std::string& directory,
+                             std::vector<Entry> entries, bool complete,
+                             const std::string& error) {
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& entry1, const Entry& entry2) {
+              if (entry1.is_directory != entry2.is_directory)
+                return entry1.is_directory;
+              return entry1.name < entry2.name;
+            });
+  auto listing = std::make_shared<Listing>();
+  listing->entries = std::move(entries);
+  listing->complete = complete;
+  listing->error = error;
+
+  std::vector<std::string> evicted;
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = listings.find(directory);
+    if (cached == listings.end()) {
+      recently_used.push_front(directory);
+      cached = listings.emplace(directory, Cached{nullptr, false,
+                                                  recently_used.begin()})
+                   .first;
+    }
+    cached->second.listing = std::move(listing);
+    while (listings.size() > capacity) {
+      evicted.push_back(recently_used.back());
+      listings.erase(recently_used.back());
+      recently_used.pop_back();
+    }
+    callback = on_change;
+  }
+  for (const auto& directory : evicted) unwatch(directory);
+  if (callback) callback();
+}
+
+void DirectoryCache::watch(const std::string& directory) {
+#ifdef __linux__
+  if (inotify_fd < 0 || watched.count(directory)) return;
+  int wd = inotify_add_watch(inotify_fd, directory.c_str(),
+                             IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                 IN_ONLYDIR);
+  if (wd < 0) return;
+  watches[wd] = directory;
+  watched[directory] = wd;
+#endif
+}
+
+void DirectoryCache::unwatch(const std::string& directory) {
+#ifdef __linux__
+  auto it = watched.find(directory);
+  if (it == watched.end()) return;
+  inotify_rm_watch(inotify_fd, it->second);
+  watches.erase(it->second);
+  watched.erase(it);
+#endif
+}
+
+void DirectoryCache::read_events() {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[4096];
+  std::vector<std::string> changed;
+  bool overflow = false;
+  ssize_t length;
+  while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+    for (char* next = buffer; next < buffer + length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(next);
+      next += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        overflow = true;
+        continue;
+      }
+      auto watch = watches.find(event->wd);
+      if (watch == watches.end()) continue;
+      changed.push_back(watch->second);
+      // The directory is gone, the kernel already dropped the watch.
+      if (event->mask & IN_IGNORED) {
+        watched.erase(watch->second);
+        watches.erase(watch);
+      }
+    }
+  }
+  if (changed.empty() && !overflow) return;
+
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (overflow) {
+      for (auto& [directory, cached] : listings) cached.stale = true;
+    }
+    for (const auto& directory : changed) {
+      auto cached = listings.find(directory);
+      if (cached != listings.end()) cached->second.stale = true;
+    }
+    callback = on_change;
+  }
+  if (callback) callback();
+#endif
+}
+
+}  // namespace gui
@@ -0,0 +1,103 @@
+#ifndef DIRECTORY_CACHE_HPP
+#define DIRECTORY_CACHE_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gui {
+
+namespace fs = std::filesystem;
+
+// Directory listings for the file dialogs, scanned on a thread of their own
+// and kept until the directory changes. The file type of every entry is
+// taken once, from the directory itself where the file system provides it,
+// so listing and sorting do not stat every file.
+//
+// On Linux listings are invalidated through inotify. Elsewhere watching()
+// is false and callers refresh() instead. inotify only sees changes made on
+// this machine, so listings of network file systems can still go stale.
+class DirectoryCache {
+ public:
+  struct Entry {
+    fs::path path;
+    std::string name;
+    bool is_directory;
+  };
+  struct Listing {
+    // Directories first, then by name.
+    std::vector<Entry> entries;
+    // False while the first scan of a directory is still running, entries
+    // then are what was found so far.
+    bool complete = false;
+    std::string error;
+  };
+  using ListingPtr = std::shared_ptr<const Listing>;
+
+ private:
+  struct Cached {
+    ListingPtr listing;
+    // Changed since the listing was taken, it is still shown until the
+    // rescan is done.
+    bool stale = false;
+    std::list<std::string>::iterator recently_used;
+  };
+
+  size_t capacity;
+  std::list<std::string> recently_used;
+  std::unordered_map<std::string, Cached> listings;
+
+  std::mutex mutex;
+  std::optional<fs::path> request;
+  std::optional<std::string> scanning;
+  std::atomic<bool> interrupt{false};
+  bool stop = false;
+  std::function<void()> on_change;
+
+  int inotify_fd = -1;
+  int wake_fds[2] = {-1, -1};
+  // Watch descriptors and their directories, only used on the scan thread,
+  // or in get() when there is none.
+  std::unordered_map<int, std::string> watches;
+  std::unordered_map<std::string, int> watched;
+  std::thread thread;
+
+  void run();
+  void wake();
+  void scan(const fs::path& directory);
+  void publish(const std::string& directory, std::vector<Entry> entries,
+               bool complete, const std::string& error);
+  void watch(const std::string& directory);
+  void unwatch(const std::string& directory);
+  void read_events();
+
+ public:
+  explicit DirectoryCache(size_t capacity = 64);
+  ~DirectoryCache();
+  DirectoryCache(const DirectoryCache&) = delete;
+  DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+  // Returns the listing of directory, which should be canonical, as far as
+  // it is known. Schedules a scan when there is none or it is stale, and
+  // returns nullptr until the scan found something. If the scan thread
+  // could not be started, scans right away instead.
+  ListingPtr get(const fs::path& directory);
+  // Marks every listing stale.
+  void refresh();
+  bool watching() const { return inotify_fd >= 0; }
+  // Called on the scan thread whenever a listing was added or replaced, or
+  // from get() when it scans itself.
+  void set_on_change(std::function<void()> callback);
+};
+
+}  // namespace gui
+
+#endif
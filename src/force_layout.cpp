@@ -0,0 +1,292 @@
+#include "force_layout.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include "thread_pool.h"
+
+namespace gui {
+
+namespace {
+
+// Lengths are in slots, like the layered layout.
+const float IDEAL_EDGE_LENGTH = 2.f;
+const float THETA = 0.8f;
+const float GRAVITY = 0.01f;
+const float COOLING = 0.95f;
+// Fraction of the initial extent a node may move in the first step.
+const float INITIAL_TEMPERATURE = 0.05f;
+const float CONVERGED_MOVE = 0.01f;
+const unsigned MAX_ITERATIONS = 500;
+const int MAX_TREE_DEPTH = 24;
+const float MIN_DISTANCE2 = 1e-6f;
+const size_t MIN_CHUNK = 1024;
+
+int quadrant(const ImVec2& min, float half, const ImVec2& p) {
+  return (p.x >= min.x + half ? 1 : 0) | (p.y >= min.y + half ? 2 : 0);
+}
+
+}  // namespace
+
+void QuadTree::build(const std::vector<ImVec2>& points) {
+  cells.clear();
+  if (points.empty()) return;
+  ImVec2 min = points[0], max = points[0];
+  for (const auto& p : points) {
+    min = ImVec2(std::min(min.x, p.x), std::min(min.y, p.y));
+    max = ImVec2(std::max(max.x, p.x), std::max(max.y, p.y));
+  }
+  float size = std::max(max.x - min.x, max.y - min.y) * 1.001f + 1e-3f;
+  cells.push_back({min, size, 0, ImVec2(0, 0), -1, -1});
+
+  for (uint32_t i = 0; i < points.size(); i++) {
+    const ImVec2& p = points[i];
+    int32_t c = 0;
+    for (int depth = 0;; depth++) {
+      if (cells[c].first_child < 0) {
+        if (cells[c].mass == 0) {
+          cells[c].point = i;
+        } else if (depth < MAX_TREE_DEPTH) {
+          // Split the leaf, its point moves one level down.
+          int32_t first = cells.size();
+          float half = cells[c].size / 2;
+          ImVec2 corner = cells[c].min;
+          for (int q = 0; q < 4; q++)
+            cells.push_back({ImVec2(corner.x + (q & 1) * half,
+                                    corner.y + (q >> 1) * half),
+                             half, 0, ImVec2(0, 0), -1, -1});
+          int32_t old = cells[c].point;
+          Cell& moved = cells[first + quadrant(corner, half, points[old])];
+          moved.point = old;
+          moved.mass = 1;
+          moved.moment = points[old];
+          cells[c].first_child = first;
+          cells[c].point = -1;
+        }
+      }
+      Cell& cell = cells[c];
+      cell.mass += 1;
+      cell.moment = ImVec2(cell.moment.x + p.x, cell.moment.y + p.y);
+      if (cell.first_child < 0) break;
+      c = cell.first_child + quadrant(cell.min, cell.size / 2, p);
+    }
+  }
+}
+
+ImVec2 QuadTree::repulsion(const ImVec2& p, uint32_t self, float theta,
+                           float k2) const {
+  ImVec2 force(0, 0);
+  if (cells.empty()) return force;
+  int32_t stack[4 * MAX_TREE_DEPTH + 4];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Cell& cell = cells[stack[--top]];
+    if (cell.mass == 0) continue;
+    if (cell.first_child < 0 && cell.point == int32_t(self) && cell.mass == 1)
+      continue;
+    float dx = p.x - cell.moment.x / cell.mass;
+    float dy = p.y - cell.moment.y / cell.mass;
+    float d2 = dx * dx + dy * dy;
+    if (cell.first_child >= 0 && cell.size * cell.size >= theta * theta * d2) {
+      for (int q = 0; q < 4; q++) stack[top++] = cell.first_child + q;
+      continue;
+    }
+    if (d2 < MIN_DISTANCE2) continue;
+    float scale = k2 * cell.mass / d2;
+    force = ImVec2(force.x + dx * scale, force.y + dy * scale);
+  }
+  return force;
+}
+
+ForceLayout::ForceLayout(unsigned threads)
+    : threads(std::max(1u, threads)), thread([this] { run(); }) {}
+
+ForceLayout::~ForceLayout() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+    latest_generation++;
+  }
+  wake_up.notify_one();
+  thread.join();
+}
+
+unsigned long ForceLayout::submit(LayoutGraph graph) {
+  unsigned long generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation = ++latest_generation;
+    graph.generation = generation;
+    pending = std::move(graph);
+    busy = true;
+  }
+  wake_up.notify_one();
+  return generation;
+}
+
+void ForceLayout::cancel() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    latest_generation++;
+    pending.reset();
+    // A running graph clears busy itself once it sees the cancel.
+    if (!running) busy = false;
+  }
+  finished_cv.notify_all();
+}
+
+bool ForceLayout::take_positions(unsigned long generation,
+                                 std::vector<ImVec2>& slots, Stats& stats) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (published_stats.generation != generation ||
+      published_iteration == taken_iteration)
+    return false;
+  taken_iteration = published_iteration;
+  slots = published;
+  stats = published_stats;
+  return true;
+}
+
+void ForceLayout::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  finished_cv.wait(lock, [this] { return !busy; });
+}
+
+void ForceLayout::set_on_progress(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  on_progress = std::move(callback);
+}
+
+void ForceLayout::run() {
+  while (true) {
+    LayoutGraph graph;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake_up.wait(lock, [this] { return stop || pending; });
+      if (stop) return;
+      graph = std::move(*pending);
+      pending.reset();
+      running = true;
+    }
+    simulate(graph);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+      if (!pending) busy = false;
+    }
+    finished_cv.notify_all();
+  }
+}
+
+void ForceLayout::simulate(const LayoutGraph& graph) {
+  auto start = std::chrono::steady_clock::now();
+  unsigned long generation = graph.generation;
+  auto is_cancelled = [this, generation] {
+    return generation != latest_generation.load(std::memory_order_relaxed);
+  };
+  uint32_t node_count = graph.node_count;
+  std::vector<ImVec2> positions = graph.previous;
+  positions.resize(node_count, ImVec2(0, 0));
+  // Nodes on the same spot have no direction to be pushed apart in.
+  for (uint32_t i = 0; i < node_count; i++) {
+    uint32_t hash = i * 2654435761u;
+    positions[i].x += ((hash & 0xffff) / 65535.f - 0.5f) * 1e-2f;
+    positions[i].y += ((hash >> 16) / 65535.f - 0.5f) * 1e-2f;
+  }
+
+  // Springs pull both ways.
+  std::vector<uint32_t> offsets(node_count + 1, 0);
+  for (const auto& [caller, callee] : graph.edges) {
+    if (caller == callee) continue;
+    offsets[caller + 1]++;
+    offsets[callee + 1]++;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<uint32_t> neighbors(offsets.back());
+  std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+  for (const auto& [caller, callee] : graph.edges) {
+    if (caller == callee) continue;
+    neighbors[next[caller]++] = callee;
+    neighbors[next[callee]++] = caller;
+  }
+
+  ImVec2 min(0, 0), max(0, 0);
+  if (node_count > 0) min = max = positions[0];
+  for (const auto& p : positions) {
+    min = ImVec2(std::min(min.x, p.x), std::min(min.y, p.y));
+    max = ImVec2(std::max(max.x, p.x), std::max(max.y, p.y));
+  }
+  float temperature =
+      std::max(IDEAL_EDGE_LENGTH,
+               INITIAL_TEMPERATURE * std::max(max.x - min.x, max.y - min.y));
+
+  if (!pool) pool = std::make_unique<ThreadPool>(threads);
+  size_t chunk = std::max<size_t>(
+      MIN_CHUNK, (node_count + threads * 4 - 1) / (threads * 4));
+  QuadTree tree;
+  std::vector<ImVec2> displacement(node_count);
+  const float k2 = IDEAL_EDGE_LENGTH * IDEAL_EDGE_LENGTH;
+  Stats stats;
+  stats.generation = generation;
+
+  for (unsigned iteration = 1; iteration <= MAX_ITERATIONS; iteration++) {
+    if (is_cancelled()) return;
+    tree.build(positions);
+    ImVec2 centroid(0, 0);
+    for (const auto& p : positions)
+      centroid = ImVec2(centroid.x + p.x, centroid.y + p.y);
+    if (node_count > 0)
+      centroid = ImVec2(centroid.x / node_count, centroid.y / node_count);
+
+    for (size_t first = 0; first < node_count; first += chunk) {
+      size_t last = std::min<size_t>(node_count, first + chunk);
+      pool->Submit([&, first, last](unsigned) {
+        for (size_t i = first; i < last; i++) {
+          const ImVec2& p = positions[i];
+          ImVec2 force = tree.repulsion(p, i, THETA, k2);
+          for (uint32_t n = offsets[i]; n < offsets[i + 1]; n++) {
+            const ImVec2& q = positions[neighbors[n]];
+            float dx = q.x - p.x, dy = q.y - p.y;
+            float scale = std::sqrt(dx * dx + dy * dy) / IDEAL_EDGE_LENGTH;
+            force = ImVec2(force.x + dx * scale, force.y + dy * scale);
+          }
+          force = ImVec2(force.x + (centroid.x - p.x) * GRAVITY,
+                         force.y + (centroid.y - p.y) * GRAVITY);
+          float length = std::sqrt(force.x * force.x + force.y * force.y);
+          float limit = length > temperature ? temperature / length : 1.f;
+          displacement[i] = ImVec2(force.x * limit, force.y * limit);
+        }
+      });
+    }
+    pool->Wait();
+
+    float max_move2 = 0;
+    for (uint32_t i = 0; i < node_count; i++) {
+      const ImVec2& d = displacement[i];
+      positions[i] = ImVec2(positions[i].x + d.x, positions[i].y + d.y);
+      max_move2 = std::max(max_move2, d.x * d.x + d.y * d.y);
+    }
+    temperature *= COOLING;
+
+    stats.iterations = iteration;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    stats.converged = max_move2 < CONVERGED_MOVE * CONVERGED_MOVE;
+    std::function<void()> callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (is_cancelled()) return;
+      published = positions;
+      published_stats = stats;
+      published_iteration++;
+      callback = on_progress;
+    }
+    if (callback) callback();
+    if (stats.converged) return;
+  }
+}
+
+}  // namespace gui
@@ -0,0 +1,104 @@
+#ifndef FORCE_LAYOUT_HPP
+#define FORCE_LAYOUT_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "imgui.h"
+#include "layered_layout.hpp"
+
+class ThreadPool;
+
+namespace gui {
+
+// Barnes-Hut quadtree over points. Cells whose size seen from a point is
+// below theta act as a single body at their center of mass, so the
+// repulsion on a point costs O(log n).
+class QuadTree {
+ private:
+  struct Cell {
+    ImVec2 min;
+    float size;
+    float mass;
+    // Sum of the positions below, center of mass times mass.
+    ImVec2 moment;
+    // Four consecutive children, or -1 for a leaf.
+    int32_t first_child;
+    // Point of a leaf, -1 when empty. Points closer than the depth limit
+    // share one leaf.
+    int32_t point;
+  };
+  std::vector<Cell> cells;
+
+ public:
+  void build(const std::vector<ImVec2>& points);
+  // Sum of k2 * (p - q) / |p - q|^2 over all points q but point self.
+  ImVec2 repulsion(const ImVec2& p, uint32_t self, float theta, float k2) const;
+};
+
+// Fruchterman-Reingold layout with Barnes-Hut repulsion, for the cluster
+// structure of large graphs. It runs on its own thread and computes the
+// forces of every step on a thread pool. Each step is published, so the
+// graph can be drawn while it settles.
+class ForceLayout {
+ public:
+  struct Stats {
+    unsigned long generation = 0;
+    unsigned iterations = 0;
+    double milliseconds = 0;
+    bool converged = false;
+  };
+
+ private:
+  std::mutex mutex;
+  std::condition_variable wake_up;
+  std::condition_variable finished_cv;
+  std::optional<LayoutGraph> pending;
+  std::vector<ImVec2> published;
+  Stats published_stats;
+  unsigned published_iteration = 0;
+  unsigned taken_iteration = 0;
+  std::atomic<unsigned long> latest_generation{0};
+  bool busy = false;
+  // The worker has taken a graph and not finished it yet.
+  bool running = false;
+  bool stop = false;
+  std::function<void()> on_progress;
+  unsigned threads;
+  std::unique_ptr<ThreadPool> pool;
+  std::thread thread;
+
+  void run();
+  void simulate(const LayoutGraph& graph);
+
+ public:
+  explicit ForceLayout(
+      unsigned threads = std::thread::hardware_concurrency());
+  ~ForceLayout();
+  ForceLayout(const ForceLayout&) = delete;
+  ForceLayout& operator=(const ForceLayout&) = delete;
+
+  // Starts from graph.previous, which holds a slot for every node, and
+  // abandons the graph in progress. Returns the generation of the run.
+  unsigned long submit(LayoutGraph graph);
+  // Stops the current run.
+  void cancel();
+  // Copies the newest step of run generation into slots, if there is one
+  // not taken yet.
+  bool take_positions(unsigned long generation, std::vector<ImVec2>& slots,
+                      Stats& stats);
+  // Blocks until the latest run has converged or was cancelled.
+  void wait();
+  // Called on the layout thread after every published step.
+  void set_on_progress(std::function<void()> callback);
+};
+
+}  // namespace gui
+
+#endif
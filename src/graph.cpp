@@ -1,6 +1,7 @@
 #include "graph.hpp"
 
 #include <set>
+#include <unordered_map>
 #include "keyboard.hpp"
 
 namespace gui {
@@ -17,6 +18,8 @@ void Node::init() {
   number_of_active_parents = 0;
   depth = 0;
   show_children = false;
+  has_slot = false;
+  visible_index = 0;
 }
 
 void Node::set_display_name() {
@@ -49,77 +52,127 @@ void Node::hide_neighbours() {
   }
 }
 
-void Node::draw(ImGuiWindow* window, const ImU32& line_color,
-                size_t line_thickness) {
-  if (number_of_active_parents == 0) return;
-
-  ImVec2 real_position = ImVec2(position.x + scroll_x, position.y + scroll_y);
+bool Node::contains(const ImVec2& origin, const ImVec2& point) {
+  ImVec2 real_position = get_absolute_position(origin);
+  return point.x >= real_position.x && point.y >= real_position.y &&
+         point.x < real_position.x + size.x &&
+         point.y < real_position.y + size.y;
+}
 
-  ImGui::SetNextWindowPos(real_position);
-  ImGui::SetNextWindowSize(size);
-  ImGui::BeginChild(std::to_string(function->ID()).c_str(), size, false);
+namespace {
 
-  ImVec2 position = ImVec2(real_position.x + current_node_size.x / 2,
-                           real_position.y + current_node_size.y / 2);
+// Bézier from the right side of one node to the left side of another, both
+// given by their top left corners.
+void edge_curve(const ImVec2& from, const ImVec2& to, ImVec2 (&points)[4]) {
+  points[0] = ImVec2(from.x + current_node_size.x - 5,
+                     from.y + current_node_size.y / 2);
+  points[3] = ImVec2(to.x + 5, to.y + current_node_size.y / 2);
+  points[1] = ImVec2(points[0].x + current_node_size.x / 2, points[0].y);
+  points[2] = ImVec2(points[0].x, points[3].y);
+}
 
-  float node_radius = current_node_size.x / 2;
+}  // namespace
 
-  window->DrawList->AddCircleFilled(position, node_radius, col32Node, 256);
-  window->DrawList->AddText(ImVec2(position.x - current_node_size.x / 2,
-                                   position.y + node_radius + 5.f),
-                            col32Text, display_name);
+ImRect Node::bounds(float label_width, float label_height) {
+  // The label hangs below the circle and may be wider than the node.
+  return ImRect(position,
+                ImVec2(position.x + std::max(size.x, label_width),
+                       position.y + current_node_size.y / 2 +
+                           current_node_size.x / 2 + 5.f + label_height));
+}
 
-  ImGuiWindow* node_window = ImGui::GetCurrentWindow();
+ImRect Node::edge_bounds(Node* neighbor, float line_thickness,
+                         const ImVec2* bends, size_t bend_count) {
+  bool forward = position.x <= neighbor->position.x;
+  Node* left = forward ? this : neighbor;
+  Node* right = forward ? neighbor : this;
+  ImVec2 points[4];
+  edge_curve(left->position, right->position, points);
+  ImRect rect(points[0], points[0]);
+  for (const auto& point : points) rect.Add(point);
+  // Segments between bends stay within the box of their end points.
+  for (size_t i = 0; i < bend_count; i++)
+    rect.Add(ImVec2(bends[i].x + current_node_size.x / 2,
+                    bends[i].y + current_node_size.y / 2));
+  // Arrow heads stick out 10 px at either end.
+  rect.Expand(ImVec2(10.f + line_thickness, 5.f + line_thickness));
+  return rect;
+}
 
-  bool is_clicked = ImGui::IsMouseClicked(0);
-  bool is_hovering = ImGui::IsWindowHovered();
+void Node::draw(ImDrawList* draw_list, const ImVec2& origin, Detail detail) {
+  ImVec2 real_position = get_absolute_position(origin);
+  ImVec2 position = ImVec2(real_position.x + current_node_size.x / 2,
+                           real_position.y + current_node_size.y / 2);
 
-  if (is_hovering) hovered_node = this;
+  float node_radius = current_node_size.x / 2;
 
-  if (is_clicked && is_hovering) last_clicked_node = this;
+  // About one segment per pixel of radius keeps the outline smooth.
+  int segments = std::min(64, std::max(6, int(node_radius)));
+  draw_list->AddCircleFilled(position, node_radius, col32Node, segments);
+  if (detail == Detail::Full)
+    draw_list->AddText(ImVec2(position.x - current_node_size.x / 2,
+                              position.y + node_radius + 5.f),
+                       col32Text, display_name);
+}
 
-  if (number_of_active_parents && is_clicked && is_hovering) {
-    if (show_children)
-      hide_neighbours();
-    else
-      show_neighbours();
+// Edges run from the node further left, so back edges end in an arrow
+// pointing left.
+void Node::draw_edge(ImDrawList* draw_list, const ImVec2& origin,
+                     Node* neighbor, const ImU32& line_color,
+                     size_t line_thickness, Detail detail,
+                     const ImVec2* bends, size_t bend_count) {
+  bool forward = position.x <= neighbor->position.x;
+  Node* left = forward ? this : neighbor;
+  Node* right = forward ? neighbor : this;
+  auto center = [&origin](const ImVec2& corner) {
+    return ImVec2(origin.x + scroll_x + corner.x + current_node_size.x / 2,
+                  origin.y + scroll_y + corner.y + current_node_size.y / 2);
+  };
+  if (detail != Detail::Full) {
+    float thickness =
+        std::min<float>(line_thickness, current_node_size.x / 4);
+    ImVec2 from = center(left->position);
+    for (size_t i = 0; i < bend_count; i++) {
+      ImVec2 to = center(bends[i]);
+      draw_list->AddLine(from, to, line_color, thickness);
+      from = to;
+    }
+    draw_list->AddLine(from, center(right->position), line_color, thickness);
+    return;
   }
-
-  if (show_children) {
-    ImVec2 start_position = node_window->Pos;
-    start_position.x += current_node_size.x - 5;
-    start_position.y += current_node_size.y / 2;
-
-    for (unsigned i = 0; i < neighbors.size(); i++) {
-      Node* neighbor = neighbors.at(i);
-      if (!neighbor->number_of_active_parents) continue;
-
-      ImVec2 end_position = ImVec2(neighbor->position.x + scroll_x,
-                                   neighbor->position.y + scroll_y);
-      end_position.x += 5;
-      end_position.y += current_node_size.y / 2;
-
-      window->DrawList->AddBezierCurve(
-          start_position,
-          ImVec2(start_position.x + current_node_size.x / 2, start_position.y),
-          ImVec2(start_position.x, end_position.y), end_position, line_color,
-          line_thickness);
-      // Drawing triangles for arrow end
-      if (start_position.x + current_node_size.x / 2 <= end_position.x)
-        window->DrawList->AddTriangleFilled(
-            ImVec2(end_position.x + 10.f, end_position.y),
-            ImVec2(end_position.x, end_position.y + 5.f),
-            ImVec2(end_position.x, end_position.y - 5.f), line_color);
-      else {
-        window->DrawList->AddTriangleFilled(
-            ImVec2(start_position.x - 10.f, start_position.y),
-            ImVec2(start_position.x, start_position.y + 5.f),
-            ImVec2(start_position.x, start_position.y - 5.f), line_color);
-      }
+  ImVec2 points[4];
+  edge_curve(left->get_absolute_position(origin),
+             right->get_absolute_position(origin), points);
+  const ImVec2& start_position = points[0];
+  const ImVec2& end_position = points[3];
+
+  if (bend_count == 0) {
+    draw_list->AddBezierCurve(start_position, points[1], points[2],
+                              end_position, line_color, line_thickness);
+  } else {
+    // Horizontal tangents at the bends keep the segments joined smoothly.
+    ImVec2 from = start_position;
+    for (size_t i = 0; i <= bend_count; i++) {
+      ImVec2 to = i < bend_count ? center(bends[i]) : end_position;
+      float handle = (to.x - from.x) / 2;
+      draw_list->AddBezierCurve(from, ImVec2(from.x + handle, from.y),
+                                ImVec2(to.x - handle, to.y), to, line_color,
+                                line_thickness);
+      from = to;
     }
   }
-  ImGui::End();
-  if (ImGui::IsWindowFocused()) refresh_nodes = true;
+  // Drawing triangles for arrow end
+  if (forward)
+    draw_list->AddTriangleFilled(
+        ImVec2(end_position.x + 10.f, end_position.y),
+        ImVec2(end_position.x, end_position.y + 5.f),
+        ImVec2(end_position.x, end_position.y - 5.f), line_color);
+  else {
+    draw_list->AddTriangleFilled(
+        ImVec2(start_position.x - 10.f, start_position.y),
+        ImVec2(start_position.x, start_position.y + 5.f),
+        ImVec2(start_position.x, start_position.y - 5.f), line_color);
+  }
 }
 
 void GraphGui::set_window(ImGuiWindow* new_window) { window = new_window; }
@@ -135,27 +188,51 @@ void GraphGui::draw(clang_interface::FunctionDecl* function) {
 
   key_input_check();
   hovered_node = nullptr;
-  layers.clear();
-  layers.resize(nodes.size(), 0);
 
-  for (auto& node : nodes) {
-    node->set_position(
-        ImVec2(left_distance + window->Pos.x + node->depth * node_distance_x,
-               top_distance + window->Pos.y +
-                   layers.at(node->depth) * node_distance_y));
-    layers.at(node->depth)++;
+  if (function != selected_function) {
+    selected_function = function;
+    select_root(function);
   }
-
-  for (auto& node : nodes) {
-    if (node->function == function && root != node.get()) {
-      root = node.get();
-      graph_init();
-    }
-
-    node->draw(window, node_line_color, node_line_thickness);
+  update_layout();
+
+  // The whole graph is one item on one draw list. The canvas button keeps
+  // clicks from dragging the window, nodes are hit tested by hand.
+  ImVec2 canvas_size = ImGui::GetContentRegionAvail();
+  ImGui::InvisibleButton("canvas", ImVec2(std::max(canvas_size.x, 1.0f),
+                                          std::max(canvas_size.y, 1.0f)));
+  ImGui::SetItemAllowOverlap();
+  if (ImGui::IsItemHovered()) hovered_node = node_at(io_pointer->MousePos);
+  if (hovered_node && ImGui::IsItemClicked(0)) {
+    last_clicked_node = hovered_node;
+    if (hovered_node->show_children)
+      hovered_node->hide_neighbours();
+    else
+      hovered_node->show_neighbours();
+    invalidate_layout();
   }
 
-  if (refresh_nodes) refresh();
+  // Only what overlaps the window reaches the draw list. Edges go first so
+  // nodes are drawn on top of them.
+  ImRect view(-scroll_x, -scroll_y, window->Size.x - scroll_x,
+              window->Size.y - scroll_y);
+  if (detail == Detail::Aggregated) {
+    draw_aggregates(view);
+  } else {
+    edge_index.query(view, [&](uint32_t edge) {
+      visible_edges[edge].first->draw_edge(
+          window->DrawList, window->Pos, visible_edges[edge].second,
+          node_line_color, node_line_thickness, detail,
+          bend_positions.data() + bend_offsets[edge],
+          bend_offsets[edge + 1] - bend_offsets[edge]);
+    });
+    // Keep the layout order, later nodes are on top.
+    items_in_view.clear();
+    node_index.query(view,
+                     [&](uint32_t node) { items_in_view.push_back(node); });
+    std::sort(items_in_view.begin(), items_in_view.end());
+    for (uint32_t node : items_in_view)
+      visible_nodes[node]->draw(window->DrawList, window->Pos, detail);
+  }
 
   draw_node_info_window();
   ImGui::SetCursorScreenPos(ImVec2(window->Pos.x + 5, window->Pos.y + 25));
@@ -171,9 +248,295 @@ void GraphGui::draw(clang_interface::FunctionDecl* function) {
 	  shrink_graph();
       }
   }
+  ImGui::SameLine();
+  bool force = force_mode;
+  if (ImGui::Checkbox("Force layout", &force)) set_force_layout(force);
   ImGui::End();
 }
 
+void GraphGui::select_root(clang_interface::FunctionDecl* function) {
+  for (auto& node : nodes) {
+    if (node->function == function && root != node.get()) {
+      root = node.get();
+      graph_init();
+      return;
+    }
+  }
+}
+
+// Positions are relative to the window, scrolling and moving the window
+// are applied when drawing.
+void GraphGui::update_layout() {
+  bool changed = false;
+  if (laid_out_version != layout_version) {
+    laid_out_version = layout_version;
+    collect_visible();
+    changed = true;
+  }
+  changed |= force_mode ? take_force_positions() : take_layout();
+  if (!changed && placed_version == positions_version) return;
+  placed_version = positions_version;
+  place_visible();
+}
+
+void GraphGui::collect_visible() {
+  visible_nodes.clear();
+  visible_edges.clear();
+  bool any_placed = false;
+  for (auto& node : nodes) {
+    if (!node->number_of_active_parents) {
+      // Placed from scratch when it shows up again.
+      node->has_slot = false;
+      continue;
+    }
+    any_placed |= node->has_slot;
+    node->visible_index = visible_nodes.size();
+    visible_nodes.push_back(node.get());
+  }
+  LayoutGraph graph;
+  graph.node_count = visible_nodes.size();
+  if (root != nullptr && root->number_of_active_parents)
+    graph.root = root->visible_index;
+  for (Node* node : visible_nodes) {
+    if (!node->show_children) continue;
+    for (Node* neighbor : node->neighbors) {
+      if (!neighbor->number_of_active_parents) continue;
+      visible_edges.emplace_back(node, neighbor);
+      graph.edges.emplace_back(node->visible_index, neighbor->visible_index);
+    }
+  }
+  // Bends belong to the previous edges, the new ones are drawn straight
+  // until their layout arrives.
+  bend_offsets.assign(visible_edges.size() + 1, 0);
+  bend_slots.clear();
+
+  // Meanwhile new nodes go one column right of their rightmost placed
+  // caller, below whatever already is in that column.
+  std::vector<int> column(visible_nodes.size(), -1);
+  std::unordered_map<int, float> column_end;
+  for (Node* node : visible_nodes) {
+    if (!node->has_slot) continue;
+    float& end = column_end[int(node->slot.x)];
+    end = std::max(end, node->slot.y + 1);
+  }
+  for (const auto& [caller, callee] : visible_edges) {
+    if (caller->has_slot && !callee->has_slot)
+      column[callee->visible_index] =
+          std::max(column[callee->visible_index], int(caller->slot.x) + 1);
+  }
+  for (Node* node : visible_nodes) {
+    if (node->has_slot) continue;
+    int x = column[node->visible_index] >= 0 ? column[node->visible_index]
+                                             : node->depth;
+    float& end = column_end[x];
+    node->slot = ImVec2(x, end);
+    node->has_slot = true;
+    end += 1;
+  }
+
+  if (force_mode) {
+    // The force layout starts from wherever the nodes are.
+    graph.previous.reserve(visible_nodes.size());
+    for (Node* node : visible_nodes) graph.previous.push_back(node->slot);
+    force_generation = force_layout.submit(std::move(graph));
+    return;
+  }
+  if (any_placed) {
+    graph.previous.reserve(visible_nodes.size());
+    for (Node* node : visible_nodes) graph.previous.push_back(node->slot);
+  }
+  layout_generation = layout_worker.submit(std::move(graph));
+}
+
+void GraphGui::move_to_slots(const std::vector<ImVec2>& slots) {
+  // The node the user clicked, or the root, stays where it is on screen.
+  Node* anchor = last_clicked_node != nullptr &&
+                         last_clicked_node->number_of_active_parents
+                     ? last_clicked_node
+                     : root;
+  ImVec2 anchor_slot = anchor != nullptr ? anchor->slot : ImVec2(0, 0);
+  for (size_t i = 0; i < visible_nodes.size(); i++)
+    visible_nodes[i]->slot = slots[i];
+  if (anchor != nullptr && anchor->number_of_active_parents) {
+    scroll_x -= (anchor->slot.x - anchor_slot.x) * node_distance_x;
+    scroll_y -= (anchor->slot.y - anchor_slot.y) * node_distance_y;
+  }
+}
+
+bool GraphGui::take_layout() {
+  auto layout = layout_worker.take_result();
+  if (!layout || layout->generation != layout_generation) return false;
+  move_to_slots(layout->slots);
+  bend_offsets = std::move(layout->bend_offsets);
+  bend_slots = std::move(layout->bends);
+  last_layout = {layout->milliseconds, layout->reversed_edges,
+                 layout->crossings_before, layout->crossings,
+                 bend_slots.size()};
+  return true;
+}
+
+bool GraphGui::take_force_positions() {
+  if (!force_layout.take_positions(force_generation, force_slots, last_force))
+    return false;
+  move_to_slots(force_slots);
+  return true;
+}
+
+void GraphGui::set_force_layout(bool enabled) {
+  if (enabled == force_mode) return;
+  force_mode = enabled;
+  if (!enabled) force_layout.cancel();
+  invalidate_layout();
+}
+
+void GraphGui::place_visible() {
+  auto to_position = [this](const ImVec2& slot) {
+    return ImVec2(left_distance + slot.x * node_distance_x,
+                  top_distance + slot.y * node_distance_y);
+  };
+  for (Node* node : visible_nodes) {
+    node->set_size(current_node_size);
+    node->set_position(to_position(node->slot));
+  }
+  bend_positions.clear();
+  for (const auto& slot : bend_slots)
+    bend_positions.push_back(to_position(slot));
+
+  if (current_node_size.x >= LOD_LABEL_NODE_SIZE)
+    detail = Detail::Full;
+  else if (current_node_size.x >= LOD_AGGREGATE_NODE_SIZE)
+    detail = Detail::Simple;
+  else
+    detail = Detail::Aggregated;
+
+  bool labels = detail == Detail::Full;
+  float label_width = labels ? ImGui::CalcTextSize("WWWWWWWWWW").x : 0.f;
+  float label_height = labels ? ImGui::GetTextLineHeight() : 0.f;
+  std::vector<ImRect> node_bounds, edge_bounds;
+  node_bounds.reserve(visible_nodes.size());
+  for (Node* node : visible_nodes)
+    node_bounds.push_back(node->bounds(label_width, label_height));
+  edge_bounds.reserve(visible_edges.size());
+  for (size_t e = 0; e < visible_edges.size(); e++) {
+    edge_bounds.push_back(visible_edges[e].first->edge_bounds(
+        visible_edges[e].second, node_line_thickness,
+        bend_positions.data() + bend_offsets[e],
+        bend_offsets[e + 1] - bend_offsets[e]));
+  }
+  float cell_size = 4 * std::max<float>(node_distance_x, node_distance_y);
+  node_index.build(std::move(node_bounds), cell_size);
+  edge_index.build(std::move(edge_bounds), cell_size);
+  build_aggregates();
+}
+
+namespace {
+
+uint64_t pack_cell(const Node* node, float cell_size) {
+  ImVec2 point(node->position.x + current_node_size.x / 2,
+               node->position.y + current_node_size.y / 2);
+  int x = int(std::floor(point.x / cell_size));
+  int y = int(std::floor(point.y / cell_size));
+  return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+ImVec2 cell_center(uint64_t cell, float cell_size) {
+  return ImVec2((int32_t(cell >> 32) + 0.5f) * cell_size,
+                (int32_t(cell & 0xffffffff) + 0.5f) * cell_size);
+}
+
+struct CellPairHash {
+  size_t operator()(const std::pair<uint64_t, uint64_t>& pair) const {
+    return std::hash<uint64_t>()(pair.first * 0x9e3779b97f4a7c15ull ^
+                                 pair.second);
+  }
+};
+
+}  // namespace
+
+// Zoomed far out, nodes are counted per grid cell and drawn as one
+// density blob per cell, edges are merged per pair of cells into bundles.
+void GraphGui::build_aggregates() {
+  blobs.clear();
+  bundles.clear();
+  blob_index.clear();
+  bundle_index.clear();
+  if (detail != Detail::Aggregated) return;
+
+  std::unordered_map<uint64_t, uint32_t> blob_of_cell;
+  for (Node* node : visible_nodes) {
+    uint64_t cell = pack_cell(node, LOD_BLOB_CELL_SIZE);
+    auto [it, inserted] = blob_of_cell.try_emplace(cell, blobs.size());
+    if (inserted) {
+      ImVec2 center = cell_center(cell, LOD_BLOB_CELL_SIZE);
+      ImRect rect(center, center);
+      rect.Expand(LOD_BLOB_CELL_SIZE / 2);
+      blobs.push_back({rect, 0});
+    }
+    blobs[it->second].count++;
+  }
+
+  std::unordered_map<std::pair<uint64_t, uint64_t>, uint32_t, CellPairHash>
+      bundle_of_cells;
+  for (const auto& [from, to] : visible_edges) {
+    auto cells = std::make_pair(
+        pack_cell(from, LOD_BUNDLE_CELL_SIZE),
+        pack_cell(to, LOD_BUNDLE_CELL_SIZE));
+    auto [it, inserted] = bundle_of_cells.try_emplace(cells, bundles.size());
+    if (inserted)
+      bundles.push_back({cell_center(cells.first, LOD_BUNDLE_CELL_SIZE),
+                         cell_center(cells.second, LOD_BUNDLE_CELL_SIZE), 0});
+    bundles[it->second].count++;
+  }
+  // Heaviest first, so the per frame budget keeps the ones that matter.
+  std::sort(bundles.begin(), bundles.end(),
+            [](const Bundle& a, const Bundle& b) { return a.count > b.count; });
+
+  std::vector<ImRect> bounds;
+  bounds.reserve(blobs.size());
+  for (const auto& blob : blobs) bounds.push_back(blob.rect);
+  blob_index.build(std::move(bounds), 4 * LOD_BLOB_CELL_SIZE);
+  bounds.clear();
+  for (const auto& bundle : bundles) {
+    ImRect rect(ImMin(bundle.from, bundle.to), ImMax(bundle.from, bundle.to));
+    rect.Expand(LOD_BUNDLE_MAX_THICKNESS);
+    bounds.push_back(rect);
+  }
+  bundle_index.build(std::move(bounds), 4 * LOD_BUNDLE_CELL_SIZE);
+}
+
+void GraphGui::draw_aggregates(const ImRect& view) {
+  ImVec2 origin(window->Pos.x + scroll_x, window->Pos.y + scroll_y);
+
+  items_in_view.clear();
+  bundle_index.query(view,
+                     [&](uint32_t bundle) { items_in_view.push_back(bundle); });
+  std::sort(items_in_view.begin(), items_in_view.end());
+  if (items_in_view.size() > LOD_MAX_BUNDLES)
+    items_in_view.resize(LOD_MAX_BUNDLES);
+  for (uint32_t i : items_in_view) {
+    const Bundle& bundle = bundles[i];
+    float thickness = std::min(LOD_BUNDLE_MAX_THICKNESS,
+                               1.f + std::log2(float(bundle.count)));
+    window->DrawList->AddLine(
+        ImVec2(origin.x + bundle.from.x, origin.y + bundle.from.y),
+        ImVec2(origin.x + bundle.to.x, origin.y + bundle.to.y),
+        node_line_color, thickness);
+  }
+
+  // How many nodes a cell holds when it is packed full.
+  float capacity = (LOD_BLOB_CELL_SIZE / node_distance_x) *
+                   (LOD_BLOB_CELL_SIZE / node_distance_y);
+  ImVec4 color = ImGui::ColorConvertU32ToFloat4(col32Node);
+  blob_index.query(view, [&](uint32_t i) {
+    const Blob& blob = blobs[i];
+    color.w = std::min(1.f, 0.35f + 0.65f * blob.count / std::max(1.f, capacity));
+    window->DrawList->AddRectFilled(
+        ImVec2(origin.x + blob.rect.Min.x, origin.y + blob.rect.Min.y),
+        ImVec2(origin.x + blob.rect.Max.x, origin.y + blob.rect.Max.y),
+        ImGui::ColorConvertFloat4ToU32(color));
+  });
+}
+
 void GraphGui::calculate_depth(Node* node) {
   std::set<unsigned> visited;
 
@@ -192,10 +555,16 @@ void GraphGui::calculate_depth(Node* node) {
   }
 }
 
-void GraphGui::refresh() {
-  for (auto& node : nodes)
-    ImGui::SetWindowFocus(node->function->NameAsString().c_str());
-  refresh_nodes = false;
+// Nodes drawn later are on top, so they win.
+Node* GraphGui::node_at(const ImVec2& point) {
+  ImVec2 layout_point(point.x - window->Pos.x - scroll_x,
+                      point.y - window->Pos.y - scroll_y);
+  int topmost = -1;
+  node_index.query(ImRect(layout_point, layout_point), [&](uint32_t node) {
+    if (int(node) > topmost && visible_nodes[node]->contains(window->Pos, point))
+      topmost = node;
+  });
+  return topmost < 0 ? nullptr : visible_nodes[topmost];
 }
 
 void GraphGui::key_input_check() {
@@ -227,7 +596,7 @@ void GraphGui::key_input_check() {
   if ((hovered_node != nullptr) && io_pointer->KeyShift &&
       io_pointer->KeyCtrl && io_pointer->KeysDown[keyboard::TKey]) {
     
-    auto row = hovered_node->function->FullSourceLoc().getLineNumber();
+    auto row = hovered_node->function->Line();
 	editor_pointer->SetSelection(
           TextEditor::Coordinates(row - 1, 0),
           TextEditor::Coordinates(
@@ -236,15 +605,18 @@ void GraphGui::key_input_check() {
     hovered_node = nullptr;
   }
 
-  current_node_size.x *=
-      (100.0f - ZOOM_SPEED * io_pointer->MouseWheel) / 100.0f;
-  current_node_size.y *=
-      (100.0f - ZOOM_SPEED * io_pointer->MouseWheel) / 100.0f;
-  current_node_size.x = std::max(NODE_MIN_SIZE_X, current_node_size.x);
-  current_node_size.y = std::max(NODE_MIN_SIZE_Y, current_node_size.y);
+  if (io_pointer->MouseWheel == 0.0f) return;
+
+  set_node_size(current_node_size.x *
+                (100.0f - ZOOM_SPEED * io_pointer->MouseWheel) / 100.0f);
+}
+
+void GraphGui::set_node_size(float node_size) {
+  node_size = std::max(NODE_ZOOM_MIN_SIZE, node_size);
+  current_node_size = ImVec2(node_size, node_size);
   node_distance_x = 1.5 * current_node_size.x;
   node_distance_y = 1.5 * current_node_size.y;
-  for (auto& node : nodes) node->set_size(current_node_size);
+  invalidate_positions();
 }
 
 void GraphGui::focus_node(const std::string& node_signature) {
@@ -252,13 +624,11 @@ void GraphGui::focus_node(const std::string& node_signature) {
     if (e->function->NameAsString() == node_signature) {
       if (e->number_of_active_parents <= 0) continue;
 
-      int wx = window->Pos.x;
-      int wy = window->Pos.y;
       int wx_mid = window->Size.x / 2;
       int wy_mid = window->Size.y / 2;
 
-      int x = e->position.x - wx;
-      int y = e->position.y - wy;
+      int x = e->position.x;
+      int y = e->position.y;
 
       scroll_x = wx_mid - x - e->size.x / 2;
       scroll_y = wy_mid - y - e->size.x / 2;
@@ -268,10 +638,9 @@ void GraphGui::focus_node(const std::string& node_signature) {
 }
 
 void GraphGui::graph_init() {
-  layers.clear();
-  layers.resize(nodes.size(), 0);
   for (const auto& e : nodes) {
     e->number_of_active_parents = 0;
+    e->has_slot = false;
     e->set_display_name();
   }
 
@@ -283,40 +652,46 @@ void GraphGui::graph_init() {
        [](std::unique_ptr<Node>& a, std::unique_ptr<Node>& b) {
          return a->number_of_active_parents > b->number_of_active_parents;
        });
+  invalidate_layout();
 }
 
 void GraphGui::BuildCallGraph(clang_interface::CallGraph& call_graph) {
   last_clicked_node = nullptr;
   hovered_node = nullptr;
   root = nullptr;
-  int index = 0;
-  int main_function_index = 0;
+  selected_function = nullptr;
   nodes.clear();
+  visible_nodes.clear();
+  visible_edges.clear();
+  bend_offsets.assign(1, 0);
+  bend_slots.clear();
+  bend_positions.clear();
+  node_index.clear();
+  edge_index.clear();
+  invalidate_layout();
+  // Indexed like call_graph.nodes, before main is moved to the front.
+  std::vector<Node*> by_position;
+  by_position.reserve(call_graph.nodes.size());
   for (const auto& e : call_graph.nodes) {
     nodes.emplace_back(std::make_unique<Node>());
     nodes.back()->function = e.get();
-
-    if (nodes.back()->function->IsMain()) main_function_index = index;
-    index++;
+    by_position.push_back(nodes.back().get());
   }
   if (nodes.empty()) {
     return;
   }
-  swap(nodes.at(0), nodes.at(main_function_index));
-
-  for (const auto [from, to] : call_graph.edges) {
-    auto from_node = std::find_if(
-        nodes.begin(), nodes.end(),
-        [id = from->ID()](const auto& n) { return n->function->ID() == id; });
-
-    auto to_node = std::find_if(
-        nodes.begin(), nodes.end(),
-        [id = to->ID()](const auto& n) { return n->function->ID() == id; });
-
-    (*from_node)->add_edge((*to_node).get());
+  auto main_function =
+      std::find_if(nodes.begin(), nodes.end(),
+                   [](const auto& node) { return node->function->IsMain(); });
+  if (main_function != nodes.end()) swap(nodes.at(0), *main_function);
+
+  for (uint32_t caller = 0; caller < by_position.size(); caller++) {
+    for (const auto& edge : call_graph.Callees(caller)) {
+      by_position[caller]->add_edge(by_position[edge.callee],
+                                    edge.call_site_count);
+    }
   }
 
-
   graph_init();
 }
 
@@ -329,6 +704,10 @@ void Node::show_info() {
     ImGui::Text("\t%s %s", it->TypeAsString().c_str(),
                 it->NameAsString().c_str());
   if (function->ParamBegin() == function->ParamEnd()) ImGui::Text("\tNone");
+  unsigned call_sites = 0;
+  for (unsigned count : call_counts) call_sites += count;
+  ImGui::Text("Calls: %zu functions from %u call sites", neighbors.size(),
+              call_sites);
 }
 
 void GraphGui::draw_node_info_window() {
@@ -358,6 +737,7 @@ void GraphGui::shrink_graph() {
   if (root == nullptr) root = nodes.front().get();
 
   root->number_of_active_parents = 1;
+  invalidate_layout();
 }
 
 void GraphGui::show_full_graph() {
@@ -375,6 +755,32 @@ void GraphGui::show_full_graph() {
     node->show_neighbours();
     for (Node* neighbor : node->neighbors) s.push(neighbor);
   }
+  invalidate_layout();
+}
+
+void GraphGui::expand_levels(int levels) {
+  std::set<Node*> visited;
+
+  std::queue<std::pair<Node*, int> > s;
+  s.push(std::make_pair(root, 0));
+  while (!s.empty()) {
+    Node* node = s.front().first;
+    int level = s.front().second;
+    s.pop();
+
+    if (level >= levels || !visited.insert(node).second) continue;
+
+    node->show_neighbours();
+    for (Node* neighbor : node->neighbors)
+      s.push(std::make_pair(neighbor, level + 1));
+  }
+  invalidate_layout();
+}
+
+size_t GraphGui::visible_node_count() const {
+  return std::count_if(nodes.begin(), nodes.end(), [](const auto& node) {
+    return node->number_of_active_parents > 0;
+  });
 }
 
 }  // namespace gui
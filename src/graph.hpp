@@ -18,6 +18,9 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_internal.h"
+#include "force_layout.hpp"
+#include "layered_layout.hpp"
+#include "spatial_index.hpp"
 
 namespace gui {
 
@@ -33,9 +36,24 @@ const static float NODE_MIN_SIZE_Y = 60;
 const static float NODE_MIN_SIZE_X = NODE_MIN_SIZE_Y;
 const static float NODE_MAX_SIZE_Y = 4 * NODE_MIN_SIZE_Y;
 const static float NODE_MAX_SIZE_X = NODE_MIN_SIZE_Y;
-
-// focus value
-static bool refresh_nodes = false;
+const static float NODE_ZOOM_MIN_SIZE = 2;
+
+// level of detail, picked from the on-screen node size
+const static float LOD_LABEL_NODE_SIZE = 24;
+const static float LOD_AGGREGATE_NODE_SIZE = 6;
+const static float LOD_BLOB_CELL_SIZE = 12;
+const static float LOD_BUNDLE_CELL_SIZE = 48;
+const static float LOD_BUNDLE_MAX_THICKNESS = 6;
+const static size_t LOD_MAX_BUNDLES = 20000;
+
+enum class Detail {
+  // Bézier edges with arrows, labels.
+  Full,
+  // Straight edges, no labels.
+  Simple,
+  // Density blobs and edge bundles instead of nodes and edges.
+  Aggregated,
+};
 
 // node constants
 static ImVec2 current_node_size(NODE_MIN_SIZE_X, NODE_MIN_SIZE_Y);
@@ -47,31 +65,52 @@ struct Node {
   ImVec2 size;
   clang_interface::FunctionDecl* function;
   std::vector<Node*> neighbors;
+  // Call sites behind each edge, parallel to neighbors.
+  std::vector<unsigned> call_counts;
   char display_name[DISPLAY_NAME_LENGTH];
 
   int depth;
   bool show_children;
   size_t number_of_active_parents;
+  // Layer and position in the layer, in units of node distance.
+  ImVec2 slot;
+  bool has_slot;
+  uint32_t visible_index;
 
   void init();
   void set_display_name();
   Node();
   Node(clang_interface::FunctionDecl* _function);
 
-  inline ImVec2 get_absolute_position() {
-    return ImVec2(scroll_x + position.x, scroll_y + position.y);
+  inline ImVec2 get_absolute_position(const ImVec2& origin) {
+    return ImVec2(origin.x + scroll_x + position.x,
+                  origin.y + scroll_y + position.y);
   }
 
   inline void set_position(ImVec2 new_position) { position = new_position; }
   inline void set_depth(int new_depth) { depth = new_depth; }
   inline void set_size(ImVec2 new_size) { size = new_size; }
-  inline void add_edge(Node* node) { neighbors.push_back(node); }
+  inline void add_edge(Node* node, unsigned call_count = 1) {
+    neighbors.push_back(node);
+    call_counts.push_back(call_count);
+  }
 
   void show_neighbours();
   void hide_neighbours();
   void show_info();
-  void draw(ImGuiWindow* window, const ImU32& line_color,
-            size_t line_thickness);
+  // origin is the screen position of the graph window, bounds are in
+  // layout space.
+  bool contains(const ImVec2& origin, const ImVec2& point);
+  ImRect bounds(float label_width, float label_height);
+  // Bends are top left corners of the dummy slots a long edge runs
+  // through, in layout space, ordered from the node further left.
+  ImRect edge_bounds(Node* neighbor, float line_thickness,
+                     const ImVec2* bends = nullptr, size_t bend_count = 0);
+  void draw(ImDrawList* draw_list, const ImVec2& origin, Detail detail);
+  void draw_edge(ImDrawList* draw_list, const ImVec2& origin, Node* neighbor,
+                 const ImU32& line_color, size_t line_thickness,
+                 Detail detail, const ImVec2* bends = nullptr,
+                 size_t bend_count = 0);
 };
 
 // Last clicked node
@@ -83,7 +122,6 @@ class GraphGui {
  private:
   ImGuiWindow* window;
   std::vector<std::unique_ptr<Node>> nodes;
-  std::vector<size_t> layers;
   ImGuiIO* io_pointer;
   TextEditor* editor_pointer;
 
@@ -97,6 +135,64 @@ class GraphGui {
 
   bool& p_show;
 
+  // Expansion, a new root or a new graph bump layout_version: the visible
+  // graph goes to layout_worker, and new nodes get a provisional slot until
+  // the layered layout arrives. Zoom only bumps positions_version, slots
+  // are kept. update_layout catches up lazily. In force mode the visible
+  // graph goes to force_layout instead, and every step it publishes is
+  // swapped in.
+  unsigned layout_version = 0;
+  unsigned laid_out_version = ~0u;
+  unsigned positions_version = 0;
+  unsigned placed_version = ~0u;
+  clang_interface::FunctionDecl* selected_function = nullptr;
+  LayoutWorker layout_worker;
+  unsigned long layout_generation = 0;
+  ForceLayout force_layout;
+  unsigned long force_generation = 0;
+  bool force_mode = false;
+  std::vector<ImVec2> force_slots;
+
+  // Visible nodes and edges of the current layout and grids over them, so
+  // drawing and hit testing only touch what is in the window.
+  std::vector<Node*> visible_nodes;
+  std::vector<std::pair<Node*, Node*>> visible_edges;
+  // Bends of visible edge e are [bend_offsets[e], bend_offsets[e + 1]).
+  std::vector<uint32_t> bend_offsets;
+  std::vector<ImVec2> bend_slots;
+  std::vector<ImVec2> bend_positions;
+  SpatialIndex node_index;
+  SpatialIndex edge_index;
+  std::vector<uint32_t> items_in_view;
+
+  struct Blob {
+    ImRect rect;
+    unsigned count;
+  };
+  struct Bundle {
+    ImVec2 from;
+    ImVec2 to;
+    unsigned count;
+  };
+  Detail detail = Detail::Full;
+  std::vector<Blob> blobs;
+  std::vector<Bundle> bundles;
+  SpatialIndex blob_index;
+  SpatialIndex bundle_index;
+
+  void build_aggregates();
+  void draw_aggregates(const ImRect& view);
+
+  void invalidate_layout() { layout_version++; }
+  void invalidate_positions() { positions_version++; }
+  void update_layout();
+  void collect_visible();
+  bool take_layout();
+  bool take_force_positions();
+  void move_to_slots(const std::vector<ImVec2>& slots);
+  void place_visible();
+  void select_root(clang_interface::FunctionDecl* function);
+
  public:
   GraphGui(ImGuiIO* io, TextEditor* editor, bool& p_show)
       : io_pointer(io), editor_pointer(editor), p_show(p_show) {}
@@ -104,7 +200,7 @@ class GraphGui {
   void set_window(ImGuiWindow* new_window);
   void draw(clang_interface::FunctionDecl* function);
   void calculate_depth(Node* node);
-  void refresh();
+  Node* node_at(const ImVec2& point);
   void key_input_check();
 
   void focus_node(const std::string& node_signature);
@@ -112,6 +208,41 @@ class GraphGui {
   void graph_init();
   void shrink_graph();
   void show_full_graph();
+  // Zoom, in on-screen pixels per node.
+  void set_node_size(float node_size);
+  // Expands the nodes up to levels calls away from the root.
+  void expand_levels(int levels);
+  size_t visible_node_count() const;
+  // Lays the visible graph out force-directed instead of in layers.
+  void set_force_layout(bool enabled);
+
+  struct LayoutStats {
+    double milliseconds = 0;
+    size_t reversed_edges = 0;
+    size_t crossings_before = 0;
+    size_t crossings = 0;
+    size_t bends = 0;
+  };
+  // Of the last layered layout swapped in.
+  const LayoutStats& layout_stats() const { return last_layout; }
+  // Of the last force layout step swapped in.
+  const ForceLayout::Stats& force_stats() const { return last_force; }
+  // Blocks until the layout of the current expansion is computed, or the
+  // force layout has settled. It is swapped in by the next draw.
+  void wait_for_layout() {
+    layout_worker.wait();
+    force_layout.wait();
+  }
+  // Called on a layout thread when a layout, or a force layout step, is
+  // ready to be swapped in.
+  void set_on_layout(std::function<void()> callback) {
+    layout_worker.set_on_result(callback);
+    force_layout.set_on_progress(std::move(callback));
+  }
+
+ private:
+  LayoutStats last_layout;
+  ForceLayout::Stats last_force;
 };
 
 }  // namespace gui
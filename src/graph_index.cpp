@@ -0,0 +1,324 @@
+#include "graph_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace clang_interface {
+
+namespace {
+
+class StringTable {
+ private:
+  std::string data;
+  std::unordered_map<std::string, uint32_t> offsets;
+
+ public:
+  // Offset 0 is the empty string, used for anything missing.
+  StringTable() { Add(""); }
+  uint32_t Add(const std::string& str) {
+    auto [it, inserted] = offsets.try_emplace(str, data.size());
+    if (inserted) {
+      data += str;
+      data.push_back('\0');
+    }
+    return it->second;
+  }
+  const std::string& Data() const { return data; }
+};
+
+uint64_t Align(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+}  // namespace
+
+bool WriteIndex(const CallGraph& call_graph, const std::string& path,
+                std::string& error_message) {
+  using namespace index_format;
+
+  const uint32_t node_count = call_graph.nodes.size();
+  const uint32_t edge_count = call_graph.EdgeCount();
+
+  if (call_graph.callee_offsets.size() != node_count + 1) {
+    error_message = "call graph adjacency was not built";
+    return false;
+  }
+
+  StringTable strings;
+  std::vector<Node> nodes;
+  std::vector<Param> params;
+  nodes.reserve(node_count);
+  for (const auto& function : call_graph.nodes) {
+    Node node{};
+    node.id = function->ID();
+    node.usr = strings.Add(function->USR());
+    node.name = strings.Add(function->NameAsString());
+    node.return_type = strings.Add(function->ReturnTypeAsString());
+    node.file_name = strings.Add(function->FileName());
+    node.line = function->Line();
+    node.column = function->Column();
+    node.first_param = params.size();
+    for (auto param = function->ParamBegin(); param != function->ParamEnd();
+         ++param) {
+      params.push_back({param->ID(), strings.Add(param->NameAsString()),
+                        strings.Add(param->TypeAsString())});
+    }
+    node.param_count = params.size() - node.first_param;
+    node.flags = (function->IsMain() ? IS_MAIN : 0) |
+                 (function->IsDefinition() ? IS_DEFINITION : 0);
+    nodes.push_back(node);
+  }
+
+  std::vector<CallSite> call_sites = call_graph.call_sites;
+  std::vector<uint32_t> file_offsets;
+  file_offsets.reserve(call_graph.files.size());
+  for (const auto& file : call_graph.files) {
+    file_offsets.push_back(strings.Add(file));
+  }
+  for (auto& site : call_sites) {
+    site.file = file_offsets[site.file];
+  }
+
+  std::vector<uint32_t> usr_order(node_count);
+  std::iota(usr_order.begin(), usr_order.end(), 0);
+  std::sort(usr_order.begin(), usr_order.end(), [&](uint32_t a, uint32_t b) {
+    return call_graph.nodes[a]->USR() < call_graph.nodes[b]->USR();
+  });
+
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.node_count = node_count;
+  header.param_count = params.size();
+  header.edge_count = edge_count;
+  header.call_site_count = call_graph.call_sites.size();
+  uint64_t offset = Align(sizeof(Header));
+  auto place = [&offset](uint64_t bytes) {
+    uint64_t section = offset;
+    offset = Align(offset + bytes);
+    return section;
+  };
+  header.strings_size = strings.Data().size();
+  header.strings_offset = place(header.strings_size);
+  header.nodes_offset = place(nodes.size() * sizeof(Node));
+  header.params_offset = place(params.size() * sizeof(Param));
+  header.callee_offsets_offset = place((node_count + 1) * 4);
+  header.callees_offset = place(edge_count * sizeof(CalleeEdge));
+  header.caller_offsets_offset = place((node_count + 1) * 4);
+  header.callers_offset = place(edge_count * 4);
+  header.call_sites_offset =
+      place(header.call_site_count * sizeof(CallSite));
+  header.usr_order_offset = place(usr_order.size() * 4);
+  header.file_size = offset;
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    error_message = "can not open " + path + " for writing";
+    return false;
+  }
+  uint64_t written = 0;
+  auto write_at = [&](uint64_t section, const void* bytes, size_t size) {
+    static const char padding[8] = {};
+    out.write(padding, section - written);
+    out.write(static_cast<const char*>(bytes), size);
+    written = section + size;
+  };
+  write_at(0, &header, sizeof(header));
+  write_at(header.strings_offset, strings.Data().data(), header.strings_size);
+  write_at(header.nodes_offset, nodes.data(), nodes.size() * sizeof(Node));
+  write_at(header.params_offset, params.data(), params.size() * sizeof(Param));
+  write_at(header.callee_offsets_offset, call_graph.callee_offsets.data(),
+           (node_count + 1) * 4);
+  write_at(header.callees_offset, call_graph.callees.data(),
+           edge_count * sizeof(CalleeEdge));
+  write_at(header.caller_offsets_offset, call_graph.caller_offsets.data(),
+           (node_count + 1) * 4);
+  write_at(header.callers_offset, call_graph.callers.data(), edge_count * 4);
+  write_at(header.call_sites_offset, call_sites.data(),
+           header.call_site_count * sizeof(CallSite));
+  write_at(header.usr_order_offset, usr_order.data(), usr_order.size() * 4);
+  write_at(header.file_size, nullptr, 0);
+
+  if (!out) {
+    error_message = "failed writing " + path;
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<MappedIndex> MappedIndex::Open(const std::string& path,
+                                               std::string& error_message) {
+  using namespace index_format;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error_message = "can not open " + path;
+    return nullptr;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t)sizeof(Header)) {
+    close(fd);
+    error_message = path + " is not a call graph index";
+    return nullptr;
+  }
+  void* mapping =
+      mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    error_message = "can not map " + path;
+    return nullptr;
+  }
+
+  std::unique_ptr<MappedIndex> index(new MappedIndex());
+  index->data = static_cast<const char*>(mapping);
+  index->size = file_stat.st_size;
+  index->header = reinterpret_cast<const Header*>(index->data);
+
+  const Header& header = *index->header;
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    error_message = path + " is not a call graph index";
+    return nullptr;
+  }
+  if (header.version != VERSION) {
+    error_message = path + " has index version " +
+                    std::to_string(header.version) + ", expected " +
+                    std::to_string(VERSION);
+    return nullptr;
+  }
+  auto fits = [&](uint64_t offset, uint64_t bytes) {
+    return offset <= index->size && bytes <= index->size - offset;
+  };
+  uint64_t nodes = header.node_count;
+  uint64_t edges = header.edge_count;
+  if (header.file_size != index->size || header.strings_size == 0 ||
+      !fits(header.strings_offset, header.strings_size) ||
+      index->data[header.strings_offset + header.strings_size - 1] != '\0' ||
+      !fits(header.nodes_offset, nodes * sizeof(index_format::Node)) ||
+      !fits(header.params_offset, header.param_count * sizeof(index_format::Param)) ||
+      !fits(header.callee_offsets_offset, (nodes + 1) * 4) ||
+      !fits(header.callees_offset, edges * sizeof(CalleeEdge)) ||
+      !fits(header.caller_offsets_offset, (nodes + 1) * 4) ||
+      !fits(header.callers_offset, edges * 4) ||
+      !fits(header.call_sites_offset,
+            header.call_site_count * sizeof(CallSite)) ||
+      !fits(header.usr_order_offset, nodes * 4) ||
+      !index->Valid()) {
+    error_message = path + " is truncated or corrupt";
+    return nullptr;
+  }
+  return index;
+}
+
+bool MappedIndex::Valid() const {
+  using namespace index_format;
+
+  auto is_string = [&](uint32_t offset) {
+    return offset < header->strings_size;
+  };
+  auto is_node = [&](uint32_t node) { return node < header->node_count; };
+  // Offsets start at 0, never decrease and end at edge_count.
+  auto is_csr = [&](Span<uint32_t> offsets) {
+    return offsets.first[0] == 0 &&
+           offsets.first[header->node_count] == header->edge_count &&
+           std::is_sorted(offsets.begin(), offsets.end());
+  };
+
+  for (uint32_t i = 0; i < header->param_count; i++) {
+    const auto& param = Param(i);
+    if (!is_string(param.name) || !is_string(param.type)) return false;
+  }
+  for (uint32_t i = 0; i < header->node_count; i++) {
+    const auto& node = Node(i);
+    if (!is_string(node.usr) || !is_string(node.name) ||
+        !is_string(node.return_type) || !is_string(node.file_name) ||
+        node.first_param > header->param_count ||
+        node.param_count > header->param_count - node.first_param) {
+      return false;
+    }
+  }
+  if (!is_csr(CalleeOffsets()) || !is_csr(CallerOffsets())) return false;
+  for (const auto& edge : AllCallees()) {
+    if (!is_node(edge.callee) ||
+        edge.first_call_site > header->call_site_count ||
+        edge.call_site_count >
+            header->call_site_count - edge.first_call_site) {
+      return false;
+    }
+  }
+  for (const auto& site : AllCallSites()) {
+    if (!is_string(site.file)) return false;
+  }
+  return std::all_of(AllCallers().begin(), AllCallers().end(), is_node) &&
+         std::all_of(Section<uint32_t>(header->usr_order_offset),
+                     Section<uint32_t>(header->usr_order_offset) +
+                         header->node_count,
+                     is_node);
+}
+
+MappedIndex::~MappedIndex() {
+  if (data) {
+    munmap(const_cast<char*>(data), size);
+  }
+}
+
+std::optional<uint32_t> MappedIndex::FindByUSR(std::string_view usr) const {
+  const uint32_t* order = Section<uint32_t>(header->usr_order_offset);
+  const uint32_t* last = order + NodeCount();
+  auto found = std::lower_bound(order, last, usr, [&](uint32_t node, auto key) {
+    return String(Node(node).usr) < key;
+  });
+  if (found == last || String(Node(*found).usr) != usr) {
+    return std::nullopt;
+  }
+  return *found;
+}
+
+CallGraph CallGraphFromIndex(const MappedIndex& index) {
+  CallGraph call_graph;
+  call_graph.nodes.reserve(index.NodeCount());
+  for (uint32_t i = 0; i < index.NodeCount(); i++) {
+    const auto& node = index.Node(i);
+    std::vector<ParamVarDecl> params;
+    params.reserve(node.param_count);
+    for (uint32_t p = node.first_param; p < node.first_param + node.param_count;
+         p++) {
+      const auto& param = index.Param(p);
+      params.emplace_back(param.id, std::string(index.String(param.name)),
+                          std::string(index.String(param.type)));
+    }
+    call_graph.nodes.emplace_back(std::make_unique<FunctionDecl>(
+        node.id, std::string(index.String(node.usr)),
+        std::string(index.String(node.name)),
+        std::string(index.String(node.return_type)), std::move(params),
+        std::string(index.String(node.file_name)), node.line, node.column,
+        node.flags & index_format::IS_MAIN,
+        node.flags & index_format::IS_DEFINITION));
+  }
+  auto copy = [](auto section, auto& to) {
+    to.assign(section.begin(), section.end());
+  };
+  copy(index.CalleeOffsets(), call_graph.callee_offsets);
+  copy(index.AllCallees(), call_graph.callees);
+  copy(index.CallerOffsets(), call_graph.caller_offsets);
+  copy(index.AllCallers(), call_graph.callers);
+  copy(index.AllCallSites(), call_graph.call_sites);
+  // String offsets -> indices in call_graph.files.
+  std::unordered_map<uint32_t, uint32_t> file_index;
+  for (auto& site : call_graph.call_sites) {
+    auto [it, inserted] = file_index.try_emplace(site.file);
+    if (inserted) {
+      it->second = call_graph.AddFile(std::string(index.String(site.file)));
+    }
+    site.file = it->second;
+  }
+  return call_graph;
+}
+
+};  // namespace clang_interface
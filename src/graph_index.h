@@ -0,0 +1,166 @@
+#ifndef GRAPH_INDEX_H
+#define GRAPH_INDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "clang_interface.h"
+
+namespace clang_interface {
+
+// On-disk call graph index. The file is a header followed by 8 byte aligned
+// sections, all integers are native endian uint32_t and strings are offsets
+// into a deduplicated table of NUL terminated strings:
+//
+//   header | strings | nodes | params | callee CSR | caller CSR |
+//   call sites | usr order
+//
+// Edges are unique caller -> callee pairs, stored as the CalleeEdge and
+// CallSite records of CallGraph, with the file of a call site as a string
+// offset.
+//
+// Everything is usable straight out of the mapping, nothing is parsed.
+namespace index_format {
+
+constexpr char MAGIC[8] = {'S', 'X', 'I', 'N', 'D', 'E', 'X', '\0'};
+constexpr uint32_t VERSION = 4;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t param_count;
+  uint32_t edge_count;
+  uint32_t call_site_count;
+  uint64_t file_size;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint64_t nodes_offset;
+  uint64_t params_offset;
+  // node_count + 1 offsets into callees / callers
+  uint64_t callee_offsets_offset;
+  uint64_t callees_offset;
+  uint64_t caller_offsets_offset;
+  uint64_t callers_offset;
+  uint64_t call_sites_offset;
+  // node indices sorted by USR
+  uint64_t usr_order_offset;
+};
+
+enum NodeFlags : uint32_t { IS_MAIN = 1, IS_DEFINITION = 2 };
+
+struct Node {
+  uint32_t id;
+  uint32_t usr;
+  uint32_t name;
+  uint32_t return_type;
+  uint32_t file_name;
+  uint32_t line;
+  uint32_t column;
+  uint32_t first_param;
+  uint32_t param_count;
+  uint32_t flags;
+};
+
+struct Param {
+  uint32_t id;
+  uint32_t name;
+  uint32_t type;
+};
+
+}  // namespace index_format
+
+bool WriteIndex(const CallGraph& call_graph, const std::string& path,
+                std::string& error_message);
+
+class MappedIndex {
+ private:
+  const char* data{nullptr};
+  size_t size{0};
+  const index_format::Header* header{nullptr};
+
+  template <typename T>
+  const T* Section(uint64_t offset) const {
+    return reinterpret_cast<const T*>(data + offset);
+  }
+  template <typename T>
+  Span<T> SectionSpan(uint64_t offset, size_t count) const {
+    return {Section<T>(offset), Section<T>(offset) + count};
+  }
+  template <typename T>
+  Span<T> Adjacent(uint64_t offsets_offset, uint64_t targets_offset,
+                   uint32_t node) const {
+    const uint32_t* offsets = Section<uint32_t>(offsets_offset);
+    const T* targets = Section<T>(targets_offset);
+    return {targets + offsets[node], targets + offsets[node + 1]};
+  }
+
+  MappedIndex() = default;
+  // Every string offset, node index and range in the sections is in bounds.
+  bool Valid() const;
+
+ public:
+  static std::unique_ptr<MappedIndex> Open(const std::string& path,
+                                           std::string& error_message);
+  ~MappedIndex();
+  MappedIndex(const MappedIndex&) = delete;
+  MappedIndex& operator=(const MappedIndex&) = delete;
+
+  uint32_t NodeCount() const { return header->node_count; }
+  uint32_t EdgeCount() const { return header->edge_count; }
+  const index_format::Node& Node(uint32_t node) const {
+    return Section<index_format::Node>(header->nodes_offset)[node];
+  }
+  const index_format::Param& Param(uint32_t param) const {
+    return Section<index_format::Param>(header->params_offset)[param];
+  }
+  // Strings are NUL terminated, so data() of the view is a valid C string.
+  std::string_view String(uint32_t offset) const {
+    return std::string_view(data + header->strings_offset + offset);
+  }
+  uint32_t CallSiteCount() const { return header->call_site_count; }
+  Span<CalleeEdge> Callees(uint32_t node) const {
+    return Adjacent<CalleeEdge>(header->callee_offsets_offset,
+                                header->callees_offset, node);
+  }
+  Span<uint32_t> Callers(uint32_t node) const {
+    return Adjacent<uint32_t>(header->caller_offsets_offset,
+                              header->callers_offset, node);
+  }
+  Span<CallSite> CallSites(const CalleeEdge& edge) const {
+    const CallSite* first =
+        Section<CallSite>(header->call_sites_offset) + edge.first_call_site;
+    return {first, first + edge.call_site_count};
+  }
+  std::optional<uint32_t> FindByUSR(std::string_view usr) const;
+
+  // Whole sections, laid out like the CallGraph members of the same name.
+  Span<uint32_t> CalleeOffsets() const {
+    return SectionSpan<uint32_t>(header->callee_offsets_offset,
+                                 NodeCount() + 1);
+  }
+  Span<CalleeEdge> AllCallees() const {
+    return SectionSpan<CalleeEdge>(header->callees_offset, EdgeCount());
+  }
+  Span<uint32_t> CallerOffsets() const {
+    return SectionSpan<uint32_t>(header->caller_offsets_offset,
+                                 NodeCount() + 1);
+  }
+  Span<uint32_t> AllCallers() const {
+    return SectionSpan<uint32_t>(header->callers_offset, EdgeCount());
+  }
+  Span<CallSite> AllCallSites() const {
+    return SectionSpan<CallSite>(header->call_sites_offset, CallSiteCount());
+  }
+};
+
+// Builds graph nodes for the GUI from the mapped records. Fixed size
+// records and the adjacency are copied as is, only the strings get
+// allocated.
+CallGraph CallGraphFromIndex(const MappedIndex& index);
+
+};  // namespace clang_interface
+
+#endif  // GRAPH_INDEX_H
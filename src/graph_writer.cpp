@@ -0,0 +1,203 @@
+#include "graph_writer.h"
+
+#include <cstdio>
+
+namespace clang_interface {
+
+namespace {
+
+void WriteJSONString(std::ostream& out, const std::string& str) {
+  out << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      case '\t':
+        out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out << escaped;
+        } else {
+          out << c;
+        }
+    }
+  }
+  out << '"';
+}
+
+void WriteDOTString(std::ostream& out, const std::string& str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+}  // namespace
+
+StreamingGraphWriter::StreamingGraphWriter(std::ostream* dot,
+                                           std::ostream* jsonl,
+                                           CallGraph* merged)
+    : dot(dot), jsonl(jsonl), merged(merged) {}
+
+void StreamingGraphWriter::Begin() {
+  if (dot) {
+    *dot << "digraph call_graph {\n";
+    *dot << "  node [shape=box];\n";
+  }
+}
+
+void StreamingGraphWriter::End() {
+  for (const auto& [id, function] : undefined) {
+    WriteNode(id, *function);
+  }
+  undefined.clear();
+  if (dot) {
+    *dot << "}\n";
+    dot->flush();
+  }
+  if (jsonl) {
+    jsonl->flush();
+  }
+  if (merged) {
+    merged->BuildAdjacency();
+  }
+}
+
+void StreamingGraphWriter::WriteNode(uint32_t id,
+                                     const FunctionDecl& function) {
+  if (dot) {
+    *dot << "  n" << id << " [label=";
+    WriteDOTString(*dot, function.NameAsString());
+    *dot << "];\n";
+  }
+  if (jsonl) {
+    auto& out = *jsonl;
+    out << "{\"type\":\"function\",\"id\":" << id << ",\"usr\":";
+    WriteJSONString(out, function.USR());
+    out << ",\"name\":";
+    WriteJSONString(out, function.NameAsString());
+    out << ",\"return_type\":";
+    WriteJSONString(out, function.ReturnTypeAsString());
+    out << ",\"params\":[";
+    for (auto param = function.ParamBegin(); param != function.ParamEnd();
+         ++param) {
+      out << (param == function.ParamBegin() ? "" : ",") << "{\"name\":";
+      WriteJSONString(out, param->NameAsString());
+      out << ",\"type\":";
+      WriteJSONString(out, param->TypeAsString());
+      out << '}';
+    }
+    out << "],\"file\":";
+    WriteJSONString(out, function.FileName());
+    out << ",\"line\":" << function.Line()
+        << ",\"column\":" << function.Column()
+        << ",\"main\":" << (function.IsMain() ? "true" : "false") << "}\n";
+  }
+}
+
+void StreamingGraphWriter::WriteEdge(uint32_t caller, uint32_t callee,
+                                     Span<CallSite> sites,
+                                     const std::vector<std::string>& files) {
+  if (dot) {
+    *dot << "  n" << caller << " -> n" << callee;
+    if (sites.size() > 1) {
+      *dot << " [label=\"" << sites.size() << "\"]";
+    }
+    *dot << ";\n";
+  }
+  if (jsonl) {
+    auto& out = *jsonl;
+    out << "{\"type\":\"call\",\"caller\":" << caller
+        << ",\"callee\":" << callee << ",\"sites\":[";
+    bool first = true;
+    for (const auto& site : sites) {
+      out << (first ? "[" : ",[");
+      WriteJSONString(out, files[site.file]);
+      out << ',' << site.line << ',' << site.column << ']';
+      first = false;
+    }
+    out << "]}\n";
+  }
+  call_site_count += sites.size();
+}
+
+void StreamingGraphWriter::Add(CallGraph& call_graph) {
+  std::vector<uint32_t> ids(call_graph.nodes.size());
+  for (size_t i = 0; i < call_graph.nodes.size(); i++) {
+    auto& node = call_graph.nodes[i];
+    // Functions without a USR can not be matched across translation units.
+    if (!node->USR().empty()) {
+      auto [it, inserted] = ids_by_usr.try_emplace(node->USR(), node_count);
+      if (!inserted) {
+        ids[i] = it->second;
+        auto declared = undefined.find(ids[i]);
+        if (declared != undefined.end() &&
+            PrefersDeclaration(*node, *declared->second)) {
+          undefined.erase(declared);
+          node->SetID(ids[i]);
+          WriteNode(ids[i], *node);
+          if (merged) {
+            *merged->nodes[ids[i]] = std::move(*node);
+          }
+        }
+        continue;
+      }
+    }
+    ids[i] = node_count++;
+    node->SetID(ids[i]);
+    if (!node->IsDefinition() && !node->USR().empty()) {
+      // The merged graph needs the node now, edges point to it.
+      if (merged) {
+        merged->nodes.emplace_back(std::make_unique<FunctionDecl>(*node));
+      }
+      undefined.emplace(ids[i], std::move(node));
+      continue;
+    }
+    WriteNode(ids[i], *node);
+    if (merged) {
+      merged->nodes.emplace_back(std::move(node));
+    }
+  }
+
+  std::vector<uint32_t> files;
+  if (merged) {
+    files = merged->AddFiles(call_graph.files);
+  }
+
+  for (uint32_t caller = 0; caller < ids.size(); caller++) {
+    for (const auto& edge : call_graph.Callees(caller)) {
+      uint64_t key = uint64_t(ids[caller]) << 32 | ids[edge.callee];
+      // Functions defined in headers bring the same calls to every
+      // translation unit including them.
+      if (!written_edges.insert(key).second) {
+        continue;
+      }
+      auto sites = call_graph.CallSites(edge);
+      WriteEdge(ids[caller], ids[edge.callee], sites, call_graph.files);
+      if (merged) {
+        for (auto site : sites) {
+          site.file = files[site.file];
+          merged->edges.push_back({merged->nodes[ids[caller]].get(),
+                                   merged->nodes[ids[edge.callee]].get(),
+                                   site});
+        }
+      }
+    }
+  }
+}
+
+};  // namespace clang_interface
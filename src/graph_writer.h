@@ -0,0 +1,69 @@
+#ifndef GRAPH_WRITER_H
+#define GRAPH_WRITER_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "clang_interface.h"
+
+namespace clang_interface {
+
+// Writes call graphs translation unit by translation unit, as soon as they
+// are extracted. Functions are numbered by USR on first sight and every
+// caller -> callee pair is written once, so those two tables are all that
+// stays in memory, along with the functions only declared so far. Those
+// are held back until a later unit defines them, or until End, so the
+// output points at the definition rather than a header prototype. Their
+// lines may come after the calls to them.
+//
+// DOT gets one statement per function and per edge. JSON Lines gets one
+// object per line:
+//
+//   {"type":"function","id":0,"usr":"c:@F@main#","name":"main",...}
+//   {"type":"call","caller":0,"callee":1,
+//    "sites":[["main.cc",12,5],["main.cc",14,5]]}
+//
+// Not thread safe, callers serialize Add.
+class StreamingGraphWriter {
+ private:
+  std::ostream* dot;
+  std::ostream* jsonl;
+  // Only set when the merged graph is needed afterwards, e.g. for the
+  // binary index, which has to be written sorted in one go.
+  CallGraph* merged;
+
+  std::unordered_map<std::string, uint32_t> ids_by_usr;
+  // Declaration-only functions not written yet, by ID.
+  std::map<uint32_t, std::unique_ptr<FunctionDecl>> undefined;
+  std::unordered_set<uint64_t> written_edges;
+  uint32_t node_count{0};
+  size_t call_site_count{0};
+
+  void WriteNode(uint32_t id, const FunctionDecl& function);
+  void WriteEdge(uint32_t caller, uint32_t callee, Span<CallSite> sites,
+                 const std::vector<std::string>& files);
+
+ public:
+  // Any of the outputs may be null.
+  StreamingGraphWriter(std::ostream* dot, std::ostream* jsonl,
+                       CallGraph* merged = nullptr);
+
+  void Begin();
+  // Moves the new functions of call_graph into the merged graph, if any.
+  void Add(CallGraph& call_graph);
+  // Writes the functions no unit defined.
+  void End();
+
+  uint32_t NodeCount() const { return node_count; }
+  size_t EdgeCount() const { return written_edges.size(); }
+  size_t CallSiteCount() const { return call_site_count; }
+};
+
+};  // namespace clang_interface
+
+#endif  // GRAPH_WRITER_H
@@ -4,6 +4,7 @@
 #include <climits>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -127,6 +128,24 @@ static void glfw_error_callback(int error, const char* description) {
   fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+void MainWindow::CountEvent(GLFWwindow* window) {
+  static_cast<MainWindow*>(glfwGetWindowUserPointer(window))->events++;
+}
+
+void MainWindow::WaitEvents(bool busy) {
+  if (idle_timeout <= 0 || busy || frames_to_settle > 0) {
+    glfwPollEvents();
+  } else {
+    glfwWaitEventsTimeout(idle_timeout);
+  }
+  if (events != seen_events) {
+    seen_events = events;
+    frames_to_settle = SETTLE_FRAMES;
+  } else if (frames_to_settle > 0) {
+    frames_to_settle--;
+  }
+}
+
 MainWindow::MainWindow() {
   // Setup window
   glfwSetErrorCallback(glfw_error_callback);
@@ -164,6 +183,29 @@ MainWindow::MainWindow() {
   glfwMakeContextCurrent(window);
   glfwSwapInterval(1);  // Enable vsync
 
+  // Installed before the ImGui bindings, which chain the callbacks they
+  // replace.
+  glfwSetWindowUserPointer(window, this);
+  glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int, int, int) {
+    CountEvent(w);
+  });
+  glfwSetScrollCallback(window, [](GLFWwindow* w, double, double) {
+    CountEvent(w);
+  });
+  glfwSetKeyCallback(window, [](GLFWwindow* w, int, int, int, int) {
+    CountEvent(w);
+  });
+  glfwSetCharCallback(window, [](GLFWwindow* w, unsigned) { CountEvent(w); });
+  glfwSetCursorPosCallback(window, [](GLFWwindow* w, double, double) {
+    CountEvent(w);
+  });
+  glfwSetCursorEnterCallback(window, [](GLFWwindow* w, int) { CountEvent(w); });
+  glfwSetWindowSizeCallback(window, [](GLFWwindow* w, int, int) {
+    CountEvent(w);
+  });
+  glfwSetWindowFocusCallback(window, [](GLFWwindow* w, int) { CountEvent(w); });
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) { CountEvent(w); });
+
   // Initialize OpenGL loader
 #if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
   err = gl3wInit() != 0;
@@ -219,41 +261,27 @@ void save(const char* new_filename, const std::string& buffer) {
   outfile.close();
 }
 
+// Listings come from the cache, files is only rebuilt when the listing
+// changed.
 void FileBrowser::get_directory_files(const fs::path& pathname) {
-  fs::path path(pathname);
+  auto current = directories.get(pathname);
+  if (current == listing) return;
+  listing = std::move(current);
   files.clear();
+  if (!listing) return;
 
-  files.push_back(path.parent_path());
-  for (auto& entry_it : fs::directory_iterator(pathname)) {
-    fs::path entry = fs::canonical(entry_it);
-    if (fs::is_directory(entry)) {
-      files.push_back(entry);
-    }
+  for (const auto& entry : listing->entries) {
     // filter extension .cpp .hpp .h .cc .c
-    else {
-      if (entry.extension() == ".cpp" || entry.extension() == ".hpp" ||
-          entry.extension() == ".h" || entry.extension() == ".cc" ||
-          entry.extension() == ".c")
-        files.push_back(fs::canonical(entry));
-    }
+    auto extension = entry.path.extension();
+    if (entry.is_directory || extension == ".cpp" || extension == ".hpp" ||
+        extension == ".h" || extension == ".cc" || extension == ".c")
+      files.push_back(&entry);
   }
-
-  std::sort(std::begin(files) + 1, std::end(files),
-            [](const auto entry1, const auto entry2) {
-              if (fs::is_directory(entry1)) {
-                if (!fs::is_directory(entry2)) return true;
-                return entry1.compare(entry2) <= 0;
-              } else if (fs::is_directory(entry2)) {
-                return false;
-              } else
-                return entry1.compare(entry2) <= 0;
-            });
 }
 
 void FileBrowser::draw_filebrowser(const char* action, fs::path& filename,
                                    bool& write, bool& is_clicked_OPEN) {
   ImGui::SetNextWindowSize(ImVec2(500, 400));
-  std::string name;
 
   if (ImGui::Begin(action, &is_clicked_OPEN)) {
     if (!fs::is_directory(filename)) {
@@ -261,24 +289,44 @@ void FileBrowser::draw_filebrowser(const char* action, fs::path& filename,
       filename = fs::canonical(filename).parent_path();
     }
 
+    // Without inotify, listings are taken again whenever a dialog opens.
+    int frame = ImGui::GetFrameCount();
+    if (last_drawn_frame != frame - 1 && !directories.watching())
+      directories.refresh();
+    last_drawn_frame = frame;
+
     ImGui::Text("[D] %s\n\n", filename.c_str());
     get_directory_files(filename);
 
-    for (const auto& file : files) {
-      if (file == filename.parent_path())
-        name = "<= BACK";
-      else
-        name = file.filename();
+    float footer_height = ImGui::GetFrameHeightWithSpacing() * 2 +
+                          ImGui::GetStyle().ItemSpacing.y;
+    if (warning) footer_height += ImGui::GetTextLineHeightWithSpacing();
+    ImGui::BeginChild("###files", ImVec2(0, -footer_height));
+    if (ImGui::Selectable("<= BACK")) filename = filename.parent_path();
+    if (!listing) {
+      ImGui::TextDisabled("Listing...");
+    } else if (!listing->error.empty()) {
+      ImGui::TextDisabled("%s", listing->error.c_str());
+    }
 
-      if (ImGui::Selectable(name.c_str())) {
-        if (name == "<= BACK")
-          filename = filename.parent_path();
-        else
-          filename = file;
-        if (fs::is_regular_file(filename)) {
-          new_name = name;
-          filename = filename.parent_path();
-        }
+    // Only the rows in view are submitted.
+    const DirectoryCache::Entry* clicked = nullptr;
+    ImGuiListClipper clipper(files.size());
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+        ImGui::PushID(i);
+        if (ImGui::Selectable(files[i]->name.c_str())) clicked = files[i];
+        ImGui::PopID();
+      }
+    }
+    if (listing && !listing->complete) ImGui::TextDisabled("Listing...");
+    ImGui::EndChild();
+
+    if (clicked != nullptr) {
+      if (clicked->is_directory) {
+        filename = clicked->path;
+      } else {
+        new_name = clicked->name;
       }
     }
 
@@ -317,6 +365,32 @@ void FileBrowser::draw_filebrowser(const char* action, fs::path& filename,
   }
 }
 
+void SourceCodePanel::OpenFile(const fs::path& file) {
+  fs::path path = fs::canonical(file);
+  std::string error_message;
+  auto source =
+      clang_interface::SourceBuffer::Map(path.string(), error_message);
+  if (!source) {
+    std::cerr << error_message << '\n';
+    return;
+  }
+  filename = path;
+  directory_of_last_opened_file = fs::absolute(file).remove_filename();
+
+  should_build_callgraph = true;
+  editor.SetText(source->Text());
+  opened_source = std::move(source);
+  opened_at = editor.LastTextChangeTime();
+}
+
+std::shared_ptr<const clang_interface::SourceBuffer>
+SourceCodePanel::Source() {
+  if (opened_source && editor.LastTextChangeTime() != opened_at)
+    opened_source.reset();
+  if (opened_source) return opened_source;
+  return clang_interface::SourceBuffer::FromString(editor.GetText());
+}
+
 void SourceCodePanel::Draw() {
   //*******************
   // KEY EVENTS
@@ -453,22 +527,7 @@ void SourceCodePanel::Draw() {
     file_browser.draw_filebrowser(
         "OPEN", file, write, is_clicked_OPEN);  //  editor_util/editor_util.hpp
     if (write && fs::is_regular_file(file)) {
-      filename = fs::canonical(file);
-      std::ifstream in_file(filename);
-      std::string _str;
-      directory_of_last_opened_file = fs::absolute(file).remove_filename();
-
-      std::string buffer = "";
-
-      while (std::getline(in_file, _str)) {
-        buffer.append(_str);
-        buffer.append("\n");
-      }
-
-      // graph.BuildCallgraphFromSource(buffer);
-      should_build_callgraph = true;
-      editor.SetText(buffer);
-
+      OpenFile(file);
       write = false;
       file = fs::current_path();
     }
@@ -563,11 +622,46 @@ void WindowsToggleMenu::Draw() {
   ImGui::Checkbox("AST dump", &show_ast_dump_window);
   ImGui::SameLine(450);
   ImGui::Checkbox("Function list", &show_function_list_window);
+  ImGui::SameLine(600);
+  ImGui::Checkbox("Project", &show_project_window);
+  ImGui::SameLine(750);
+  ImGui::Checkbox("Find file", &show_file_finder_window);
+  if (idle_when_inactive != nullptr) {
+    ImGui::SameLine(900);
+    ImGui::Checkbox("Idle when inactive", idle_when_inactive);
+  }
   ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+  SampleCPU();
+  ImGui::SameLine();
+  ImGui::Text(", process CPU %.1f%%", cpu_percent);
+  if (parsing) {
+    ImGui::Text("Parsing...");
+  } else if (last_parse_ms >= 0) {
+    ImGui::Text("Last parse %.1f ms (%s), call graph extraction %.1f ms",
+                last_parse_ms,
+                last_parse_reparsed ? "reparse, preamble reused" : "full parse",
+                last_extract_ms);
+  }
 
   ImGui::End();
 }
 
+void WindowsToggleMenu::SampleCPU() {
+  timespec cpu;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+  double cpu_seconds = cpu.tv_sec + cpu.tv_nsec / 1e9;
+  double wall = glfwGetTime();
+  if (cpu_sample_seconds < 0) {
+    cpu_sample_seconds = cpu_seconds;
+    cpu_sample_wall = wall;
+  } else if (wall - cpu_sample_wall >= 1) {
+    cpu_percent =
+        100 * (cpu_seconds - cpu_sample_seconds) / (wall - cpu_sample_wall);
+    cpu_sample_seconds = cpu_seconds;
+    cpu_sample_wall = wall;
+  }
+}
+
 void FunctionListFilteringWindow::Draw() {
   ImGui::Begin("Functions Filtering List", &p_open,
                ImGuiWindowFlags_NoCollapse);
@@ -616,11 +710,148 @@ void FunctionASTDumpWindow::Draw() {
   if (ImGui::IsWindowHovered() && !ImGui::IsWindowFocused())
     ImGui::SetWindowFocus();
   if (function) {
-    ImGui::Text("%s", function->ASTDump().c_str());
+    if (auto dump = dump_cache.Get(*function)) {
+      ImGui::TextUnformatted(dump->c_str(), dump->c_str() + dump->size());
+    } else {
+      ImGui::Text("Dumping %s...", function->NameAsString().c_str());
+    }
   } else {
     ImGui::Text("None");
   }
   ImGui::End();
 }
 
+void ProjectIndexWindow::Draw() {
+  ImGui::Begin("Project Index", &p_open, ImGuiWindowFlags_NoCollapse);
+  if (ImGui::IsWindowHovered() && !ImGui::IsWindowFocused())
+    ImGui::SetWindowFocus();
+
+  if (!indexer) {
+    ImGui::Text("No project, start with -p <compile_commands.json>");
+    ImGui::End();
+    return;
+  }
+
+  size_t total = indexer->TotalCount();
+  size_t done = indexer->DoneCount();
+  // Reports only grow, so they are copied again only when new ones arrived.
+  if (reports.size() != done) reports = indexer->Reports();
+
+  char progress[64];
+  sprintf(progress, "%zu/%zu", done, total);
+  ImGui::ProgressBar(total ? float(done) / total : 1.f, ImVec2(-1, 0),
+                     progress);
+  ImGui::Text("%s, failed: %zu", indexer->IsFinished() ? "Done" : "Indexing",
+              indexer->FailedCount());
+  ImGui::Separator();
+
+  ImGui::Columns(4, "translation units");
+  ImGui::Text("File");
+  ImGui::NextColumn();
+  ImGui::Text("Parse ms");
+  ImGui::NextColumn();
+  ImGui::Text("Extract ms");
+  ImGui::NextColumn();
+  ImGui::Text("Status");
+  ImGui::NextColumn();
+  ImGui::Separator();
+  // Only the visible rows, a project has thousands of units.
+  ImGuiListClipper clipper(reports.size());
+  while (clipper.Step()) {
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+      const auto& report = reports[i];
+      ImGui::Text("%s", fs::path(report.file).filename().c_str());
+      if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", report.file.c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", report.parse_ms);
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", report.extract_ms);
+      ImGui::NextColumn();
+      if (report.ok)
+        ImGui::Text("ok");
+      else
+        ImGui::TextColored(
+            ImVec4(218.f / 255.f, 10.f / 255.f, 10.f / 255.f, 1.f), "%s",
+            report.error.c_str());
+      ImGui::NextColumn();
+    }
+  }
+  ImGui::Columns(1);
+
+  ImGui::End();
+}
+
+void FileFinderWindow::Draw() {
+  if (!index.started()) index.start(root);
+
+  ImGui::SetNextWindowSize(ImVec2(600, 400), ImGuiCond_FirstUseEver);
+  if (!ImGui::Begin("Find File", &p_open, ImGuiWindowFlags_NoCollapse)) {
+    ImGui::End();
+    return;
+  }
+  if (ImGui::IsWindowHovered() && !ImGui::IsWindowFocused())
+    ImGui::SetWindowFocus();
+  if (ImGui::IsWindowAppearing()) ImGui::SetKeyboardFocusHere();
+
+  ImGui::PushItemWidth(-1);
+  bool entered = ImGui::InputTextWithHint("##query", "file name", &query,
+                                          ImGuiInputTextFlags_EnterReturnsTrue);
+  ImGui::PopItemWidth();
+  // Enter without a match keeps typing.
+  if (entered && matches.empty()) ImGui::SetKeyboardFocusHere(-1);
+
+  auto stats = index.stats();
+  if (query != searched_query || stats.version != searched_version) {
+    double start = glfwGetTime();
+    matches = index.find(query, 100);
+    last_find_ms = 1000 * (glfwGetTime() - start);
+    if (query != searched_query) selected = 0;
+    searched_query = query;
+    searched_version = stats.version;
+  }
+  int count = matches.size();
+  selected = std::min(selected, std::max(count - 1, 0));
+
+  bool moved = false;
+  if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows)) {
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_DownArrow)) &&
+        selected + 1 < count) {
+      selected++;
+      moved = true;
+    }
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_UpArrow)) &&
+        selected > 0) {
+      selected--;
+      moved = true;
+    }
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
+      p_open = false;
+  }
+
+  ImGui::Text("%zu files%s, %zu matches in %.1f ms", stats.files,
+              stats.crawling ? " so far" : "", matches.size(), last_find_ms);
+  if (stats.unwatched > 0) {
+    ImGui::SameLine();
+    ImGui::Text(", %zu directories not watched", stats.unwatched);
+  }
+  ImGui::Separator();
+
+  ImGui::BeginChild("matches");
+  for (int i = 0; i < count; i++) {
+    if (ImGui::Selectable(matches[i].path.c_str(), i == selected,
+                          ImGuiSelectableFlags_AllowDoubleClick)) {
+      selected = i;
+      entered = ImGui::IsMouseDoubleClicked(0);
+    }
+    if (i == selected && moved) ImGui::SetScrollHereY();
+  }
+  ImGui::EndChild();
+
+  if (entered && selected < count) {
+    chosen = index.root_path() / matches[selected].path;
+    p_open = false;
+  }
+  ImGui::End();
+}
+
 };  // namespace gui
@@ -1,9 +1,16 @@
 #ifndef GUI_HPP
 #define GUI_HPP
 
+#include <chrono>
 #include <filesystem>
+#include <optional>
 #include "TextEditor.h"
+#include "ast_dump_cache.h"
 #include "clang_interface.h"
+#include "directory_cache.hpp"
+#include "path_index.hpp"
+#include "project_indexer.h"
+#include "source_buffer.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -46,16 +53,42 @@ class MainWindow {
   GLFWwindow* window;
   bool err;
 
+  // Bumped by the GLFW input and window callbacks.
+  unsigned long events = 0;
+  unsigned long seen_events = 0;
+  // Frames still drawn at full rate after something happened, so ImGui
+  // settles hover and focus state before the loop goes idle.
+  int frames_to_settle = 0;
+
+  static void CountEvent(GLFWwindow* window);
+
  public:
   GLFWwindow* Window() { return window; }
 
   MainWindow();
 
   ~MainWindow();
+
+  // Seconds to block waiting for events when nothing happens, 0 polls
+  // every frame.
+  double idle_timeout = 0.5;
+  // Polls for events, or blocks for up to idle_timeout when nothing has
+  // happened for a few frames and busy is false.
+  void WaitEvents(bool busy);
+  // Keeps drawing for a few frames, e.g. after a background result
+  // arrived. Thread safe wake ups from other threads go through
+  // glfwPostEmptyEvent instead.
+  void Redraw() { frames_to_settle = SETTLE_FRAMES; }
+
+  static constexpr int SETTLE_FRAMES = 3;
 };
 
 struct FileBrowser {
-  std::vector<fs::path> files;
+  DirectoryCache directories;
+  // Shown entries of listing, directories and source files.
+  DirectoryCache::ListingPtr listing;
+  std::vector<const DirectoryCache::Entry*> files;
+  int last_drawn_frame = -1;
   bool warning = false;
   std::string new_name = "";
   std::string error_msg = "";
@@ -74,6 +107,9 @@ class SourceCodePanel {
   fs::path file = fs::current_path();
   fs::path restore_filename = "";
   std::filesystem::path directory_of_last_opened_file;
+  // The opened file, handed to the parser as is until the first edit.
+  std::shared_ptr<const clang_interface::SourceBuffer> opened_source;
+  std::chrono::system_clock::time_point opened_at;
 
   bool is_clicked_NEW = false;
   bool is_clicked_OPEN = false;
@@ -95,9 +131,21 @@ class SourceCodePanel {
     return directory_of_last_opened_file;
   }
   auto IsTextChanged() const { return editor.IsTextChanged(); }
+  // Coloring of the shown editor is not done yet.
+  bool IsColorizing() const {
+    return *show_source_code_window && editor.IsColorizing();
+  }
   bool ShouldBuildCallgraph() const { return should_build_callgraph; }
   void CallGraphBuilt() { should_build_callgraph = false; }
-  const std::string SourceCode() const { return editor.GetText(); }
+  // The editor text for the parser, the mapped file while it is unedited.
+  std::shared_ptr<const clang_interface::SourceBuffer> Source();
+  // Called from another thread when a directory listing of the file
+  // dialogs changed.
+  void SetOnDirectoryChange(std::function<void()> callback) {
+    file_browser.directories.set_on_change(std::move(callback));
+  }
+  // Loads file into the editor, as the Open dialog does.
+  void OpenFile(const fs::path& file);
   void Draw();
 };
 
@@ -108,6 +156,21 @@ class WindowsToggleMenu {
   bool show_callgraph_window = true;
   bool show_ast_dump_window = false;
   bool show_function_list_window = false;
+  bool show_project_window = false;
+  bool show_file_finder_window = false;
+
+  // Editor buffer parse status, shown next to the frame rate.
+  bool parsing = false;
+  double last_parse_ms = -1;
+  double last_extract_ms = 0;
+  bool last_parse_reparsed = false;
+
+  bool* idle_when_inactive = nullptr;
+  // Process CPU usage over the last second, to compare with idle mode off.
+  double cpu_percent = 0;
+  double cpu_sample_seconds = -1;
+  double cpu_sample_wall = 0;
+  void SampleCPU();
 
   void Draw();
 };
@@ -134,15 +197,60 @@ class FunctionListFilteringWindow {
 class FunctionASTDumpWindow {
  private:
   clang_interface::FunctionDecl* function{nullptr};
+  clang_interface::ASTDumpCache& dump_cache;
   bool& p_open;
 
  public:
-  explicit FunctionASTDumpWindow(bool& p_open) : p_open(p_open) {}
+  FunctionASTDumpWindow(bool& p_open, clang_interface::ASTDumpCache& cache)
+      : dump_cache(cache), p_open(p_open) {}
   void SetFunction(clang_interface::FunctionDecl* func) { function = func; }
   void Clear() { function = nullptr; }
   void Draw();
 };
 
+class ProjectIndexWindow {
+ private:
+  const clang_interface::ProjectIndexer* indexer{nullptr};
+  std::vector<clang_interface::TranslationUnitReport> reports;
+  bool& p_open;
+
+ public:
+  explicit ProjectIndexWindow(bool& p_open) : p_open(p_open) {}
+  void SetIndexer(const clang_interface::ProjectIndexer* new_indexer) {
+    indexer = new_indexer;
+    reports.clear();
+  }
+  void Draw();
+};
+
+// Fuzzy search over the source files below root, opened with Ctrl+P.
+class FileFinderWindow {
+ private:
+  PathIndex& index;
+  fs::path root;
+  bool& p_open;
+  std::string query;
+  std::vector<PathIndex::Match> matches;
+  // What matches were found for, searched again when either changes.
+  std::optional<unsigned long> searched_version;
+  std::string searched_query;
+  int selected = 0;
+  double last_find_ms = 0;
+  std::optional<fs::path> chosen;
+
+ public:
+  FileFinderWindow(bool& p_open, PathIndex& index, fs::path root)
+      : index(index), root(std::move(root)), p_open(p_open) {}
+  // The file picked since the last call, if any.
+  std::optional<fs::path> TakeChosenFile() {
+    auto file = std::move(chosen);
+    chosen.reset();
+    return file;
+  }
+  // Starts the index the first time it is drawn.
+  void Draw();
+};
+
 };  // namespace gui
 
 #endif  // GUI_HPP
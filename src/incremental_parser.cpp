@@ -0,0 +1,75 @@
+#include "incremental_parser.h"
+
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace clang_interface {
+
+namespace {
+
+// Same name buildASTFromCodeWithArgs gives the buffer, it never hits the disk.
+constexpr const char* MAIN_FILE_NAME = "input.cc";
+
+// ASTUnit takes ownership of remapped buffers, which only point into the
+// NUL terminated source.
+clang::ASTUnit::RemappedFile RemapMainFile(std::string_view source) {
+  return {MAIN_FILE_NAME,
+          llvm::MemoryBuffer::getMemBuffer(
+              llvm::StringRef(source.data(), source.size()), MAIN_FILE_NAME,
+              /*RequiresNullTerminator=*/true)
+              .release()};
+}
+
+}  // namespace
+
+IncrementalParser::IncrementalParser()
+    : pch_operations(std::make_shared<clang::PCHContainerOperations>()),
+      resources_path(clang::CompilerInvocation::GetResourcesPath(
+          "SourceExplorer", reinterpret_cast<void*>(&RemapMainFile))) {}
+
+bool IncrementalParser::Parse(std::shared_ptr<const SourceBuffer> source,
+                              std::vector<std::string> compiler_args) {
+  AddDefaultCompilerArgs(compiler_args);
+  // The old AST reads the old source until it is replaced.
+  auto previous_source = std::move(ast_source);
+  ast_source = std::move(source);
+  std::string_view text = ast_source->Text();
+  last_parse_was_reparse =
+      ast_unit && compiler_args == ast_compiler_args && Reparse(text);
+  if (last_parse_was_reparse) {
+    return true;
+  }
+  return Load(text, compiler_args);
+}
+
+bool IncrementalParser::Load(std::string_view source,
+                             const std::vector<std::string>& compiler_args) {
+  std::vector<const char*> argv;
+  argv.push_back("clang");
+  for (const auto& arg : compiler_args) {
+    argv.push_back(arg.c_str());
+  }
+  argv.push_back(MAIN_FILE_NAME);
+
+  auto diagnostics = clang::CompilerInstance::createDiagnostics(
+      new clang::DiagnosticOptions());
+  std::unique_ptr<clang::ASTUnit> ast(clang::ASTUnit::LoadFromCommandLine(
+      argv.data(), argv.data() + argv.size(), pch_operations, diagnostics,
+      resources_path, /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false,
+      RemapMainFile(source), /*RemappedFilesKeepOriginalName=*/true,
+      /*PrecompilePreambleAfterNParses=*/1, clang::TU_Complete));
+
+  ast_unit = ASTUnit(std::move(ast));
+  ast_compiler_args = compiler_args;
+  return static_cast<bool>(ast_unit);
+}
+
+bool IncrementalParser::Reparse(std::string_view source) {
+  // Reparse returns true on error.
+  return !ast_unit.Get().Reparse(pch_operations, RemapMainFile(source));
+}
+
+};  // namespace clang_interface
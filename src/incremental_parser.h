@@ -0,0 +1,45 @@
+#ifndef INCREMENTAL_PARSER_H
+#define INCREMENTAL_PARSER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "clang/Frontend/PCHContainerOperations.h"
+#include "clang_interface.h"
+#include "source_buffer.h"
+
+namespace clang_interface {
+
+// Keeps one live AST of the editor buffer. The first parse precompiles the
+// preamble (the #include block at the top of the file); later parses remap
+// the new buffer and Reparse, which reuses that preamble as long as the
+// include block and the compiler arguments did not change, so only the main
+// file body is parsed again.
+class IncrementalParser {
+ private:
+  ASTUnit ast_unit;
+  std::vector<std::string> ast_compiler_args;
+  std::shared_ptr<clang::PCHContainerOperations> pch_operations;
+  std::string resources_path;
+  bool last_parse_was_reparse = false;
+  // clang reads the main file straight from it, it lives as long as the AST.
+  std::shared_ptr<const SourceBuffer> ast_source;
+
+  bool Load(std::string_view source,
+            const std::vector<std::string>& compiler_args);
+  bool Reparse(std::string_view source);
+
+ public:
+  IncrementalParser();
+
+  // Brings the AST up to date with source. Returns false if clang could not
+  // build an AST at all.
+  bool Parse(std::shared_ptr<const SourceBuffer> source,
+             std::vector<std::string> compiler_args = {});
+  ASTUnit& AST() { return ast_unit; }
+  bool LastParseWasReparse() const { return last_parse_was_reparse; }
+};
+
+};  // namespace clang_interface
+
+#endif  // INCREMENTAL_PARSER_H
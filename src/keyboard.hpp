@@ -11,6 +11,7 @@ constexpr unsigned char AKey = 'A';
 constexpr unsigned char DKey = 'D';
 constexpr unsigned char TKey = 'T';
 constexpr unsigned char FKey = 'F';
+constexpr unsigned char PKey = 'P';
 };  // namespace keyboard
 
 #endif  // KEYBOARD_HPP
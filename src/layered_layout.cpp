@@ -0,0 +1,442 @@
+#include "layered_layout.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+namespace gui {
+
+namespace {
+
+// Long edges get at most this many dummy nodes per real node, edges past
+// the budget are left out of the crossing reduction and drawn without
+// bends.
+const size_t MAX_DUMMIES_PER_NODE = 8;
+const size_t MIN_DUMMY_BUDGET = 100000;
+const int MAX_SWEEPS = 12;
+const int SWEEPS_WITHOUT_GAIN = 2;
+const int PLACEMENT_PASSES = 4;
+// Gaps between neighbours in a layer, dummies pack closer.
+const float NODE_GAP = 1.f;
+const float NODE_DUMMY_GAP = 0.5f;
+const float DUMMY_GAP = 0.25f;
+
+struct Adjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> targets;
+
+  // Adjacency of pairs.first, or of pairs.second if reverse is set.
+  void build(uint32_t vertex_count,
+             const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+             bool reverse) {
+    offsets.assign(vertex_count + 1, 0);
+    for (const auto& [a, b] : pairs) offsets[(reverse ? b : a) + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    targets.resize(pairs.size());
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (const auto& [a, b] : pairs)
+      targets[next[reverse ? b : a]++] = reverse ? a : b;
+  }
+  const uint32_t* begin(uint32_t v) const {
+    return targets.data() + offsets[v];
+  }
+  const uint32_t* end(uint32_t v) const {
+    return targets.data() + offsets[v + 1];
+  }
+  bool empty(uint32_t v) const { return offsets[v] == offsets[v + 1]; }
+};
+
+// Marks the DFS back edges, which are reversed to get a DAG, and numbers
+// the nodes in DFS preorder.
+void break_cycles(const LayoutGraph& graph, std::vector<bool>& reversed,
+                  std::vector<uint32_t>& preorder) {
+  uint32_t node_count = graph.node_count;
+  std::vector<uint32_t> offsets(node_count + 1, 0);
+  for (const auto& edge : graph.edges) offsets[edge.first + 1]++;
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<uint32_t> out_edges(graph.edges.size());
+  std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+  for (uint32_t e = 0; e < graph.edges.size(); e++)
+    out_edges[next[graph.edges[e].first]++] = e;
+
+  enum : uint8_t { Unvisited, OnStack, Done };
+  std::vector<uint8_t> state(node_count, Unvisited);
+  reversed.assign(graph.edges.size(), false);
+  preorder.assign(node_count, 0);
+  uint32_t counter = 0;
+  // Node and the next of its out edges to follow.
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+  auto enter = [&](uint32_t node) {
+    state[node] = OnStack;
+    preorder[node] = counter++;
+    stack.emplace_back(node, offsets[node]);
+  };
+  auto visit = [&](uint32_t start) {
+    enter(start);
+    while (!stack.empty()) {
+      uint32_t node = stack.back().first;
+      uint32_t& edge_index = stack.back().second;
+      if (edge_index == offsets[node + 1]) {
+        state[node] = Done;
+        stack.pop_back();
+        continue;
+      }
+      uint32_t e = out_edges[edge_index++];
+      uint32_t callee = graph.edges[e].second;
+      if (state[callee] == OnStack)
+        reversed[e] = true;
+      else if (state[callee] == Unvisited)
+        enter(callee);
+    }
+  };
+  if (graph.root < node_count) visit(graph.root);
+  for (uint32_t node = 0; node < node_count; node++)
+    if (state[node] == Unvisited) visit(node);
+}
+
+// Layer of every node of the DAG, the longest path from a source.
+std::vector<uint32_t> longest_path_layers(
+    uint32_t node_count,
+    const std::vector<std::pair<uint32_t, uint32_t>>& dag) {
+  Adjacency out;
+  out.build(node_count, dag, false);
+  std::vector<uint32_t> in_degree(node_count, 0);
+  for (const auto& edge : dag) in_degree[edge.second]++;
+  std::vector<uint32_t> layer(node_count, 0);
+  std::vector<uint32_t> ready;
+  for (uint32_t node = 0; node < node_count; node++)
+    if (in_degree[node] == 0) ready.push_back(node);
+  while (!ready.empty()) {
+    uint32_t node = ready.back();
+    ready.pop_back();
+    for (auto it = out.begin(node); it != out.end(node); it++) {
+      layer[*it] = std::max(layer[*it], layer[node] + 1);
+      if (--in_degree[*it] == 0) ready.push_back(*it);
+    }
+  }
+  return layer;
+}
+
+// Crossings between all pairs of neighbouring layers, counted as
+// inversions with a Fenwick tree.
+size_t count_crossings(const std::vector<std::vector<uint32_t>>& layers,
+                       const Adjacency& down,
+                       const std::vector<uint32_t>& pos) {
+  size_t crossings = 0;
+  std::vector<uint32_t> sequence;
+  std::vector<uint32_t> tree;
+  for (size_t l = 0; l + 1 < layers.size(); l++) {
+    sequence.clear();
+    for (uint32_t v : layers[l]) {
+      size_t first = sequence.size();
+      for (auto it = down.begin(v); it != down.end(v); it++)
+        sequence.push_back(pos[*it]);
+      std::sort(sequence.begin() + first, sequence.end());
+    }
+    tree.assign(layers[l + 1].size() + 1, 0);
+    for (size_t i = 0; i < sequence.size(); i++) {
+      // Earlier segments ending at or before this one do not cross it.
+      size_t not_crossing = 0;
+      for (uint32_t k = sequence[i] + 1; k > 0; k -= k & -k)
+        not_crossing += tree[k];
+      crossings += i - not_crossing;
+      for (uint32_t k = sequence[i] + 1; k < tree.size(); k += k & -k)
+        tree[k]++;
+    }
+  }
+  return crossings;
+}
+
+// Orders one layer by the barycenter of its neighbours in the layer it
+// is swept from. Vertices without neighbours there keep their position.
+void sort_by_barycenter(std::vector<uint32_t>& layer,
+                        const Adjacency& neighbors, std::vector<uint32_t>& pos,
+                        std::vector<float>& key) {
+  for (uint32_t v : layer) {
+    if (neighbors.empty(v)) {
+      key[v] = pos[v];
+      continue;
+    }
+    float sum = 0;
+    for (auto it = neighbors.begin(v); it != neighbors.end(v); it++)
+      sum += pos[*it];
+    key[v] = sum / (neighbors.end(v) - neighbors.begin(v));
+  }
+  std::stable_sort(layer.begin(), layer.end(),
+                   [&key](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+  for (uint32_t i = 0; i < layer.size(); i++) pos[layer[i]] = i;
+}
+
+// Moves the vertices of one layer as close as possible, in the least
+// squares sense, to the mean position of their neighbours, keeping their
+// order and gaps. With offset_i the sum of the gaps before vertex i, this
+// is an isotonic regression of desired_i - offset_i, solved by pooling
+// adjacent violators.
+void place_layer(const std::vector<uint32_t>& layer, const Adjacency& neighbors,
+                 uint32_t node_count, std::vector<float>& y) {
+  struct Block {
+    float sum;
+    uint32_t count;
+    float mean() const { return sum / count; }
+  };
+  std::vector<Block> blocks;
+  std::vector<float> offsets(layer.size());
+  float offset = 0;
+  for (size_t i = 0; i < layer.size(); i++) {
+    uint32_t v = layer[i];
+    if (i > 0) {
+      bool dummy = v >= node_count, previous_dummy = layer[i - 1] >= node_count;
+      offset += dummy && previous_dummy ? DUMMY_GAP
+                : dummy || previous_dummy ? NODE_DUMMY_GAP
+                                          : NODE_GAP;
+    }
+    offsets[i] = offset;
+    float desired = y[v];
+    if (!neighbors.empty(v)) {
+      float sum = 0;
+      for (auto it = neighbors.begin(v); it != neighbors.end(v); it++)
+        sum += y[*it];
+      desired = sum / (neighbors.end(v) - neighbors.begin(v));
+    }
+    blocks.push_back({desired - offset, 1});
+    while (blocks.size() > 1 &&
+           blocks[blocks.size() - 2].mean() > blocks.back().mean()) {
+      blocks[blocks.size() - 2].sum += blocks.back().sum;
+      blocks[blocks.size() - 2].count += blocks.back().count;
+      blocks.pop_back();
+    }
+  }
+  size_t i = 0;
+  for (const auto& block : blocks) {
+    for (uint32_t k = 0; k < block.count; k++, i++)
+      y[layer[i]] = block.mean() + offsets[i];
+  }
+}
+
+}  // namespace
+
+std::optional<LayeredLayout> compute_layered_layout(
+    const LayoutGraph& graph, const std::function<bool()>& is_cancelled) {
+  auto start = std::chrono::steady_clock::now();
+  LayeredLayout layout;
+  layout.generation = graph.generation;
+  uint32_t node_count = graph.node_count;
+  size_t edge_count = graph.edges.size();
+
+  // Cycle breaking and layer assignment.
+  std::vector<bool> reversed;
+  std::vector<uint32_t> preorder;
+  break_cycles(graph, reversed, preorder);
+  std::vector<std::pair<uint32_t, uint32_t>> dag;
+  dag.reserve(edge_count);
+  for (size_t e = 0; e < edge_count; e++) {
+    auto [caller, callee] = graph.edges[e];
+    if (caller == callee) continue;
+    if (reversed[e]) layout.reversed_edges++;
+    dag.push_back(reversed[e] ? std::make_pair(callee, caller)
+                              : std::make_pair(caller, callee));
+  }
+  std::vector<uint32_t> vertex_layer = longest_path_layers(node_count, dag);
+  if (is_cancelled()) return std::nullopt;
+
+  // Long edges are split into one segment per layer by dummy vertices,
+  // numbered after the nodes.
+  std::vector<std::pair<uint32_t, uint32_t>> segments;
+  segments.reserve(dag.size());
+  std::vector<uint32_t> first_dummy(edge_count, 0);
+  std::vector<uint32_t> dummy_count(edge_count, 0);
+  // Real node a dummy hangs off, for the initial order.
+  std::vector<uint32_t> dummy_source;
+  size_t dummy_budget =
+      std::max(MIN_DUMMY_BUDGET, MAX_DUMMIES_PER_NODE * node_count);
+  for (size_t e = 0, d = 0; e < edge_count; e++) {
+    auto [caller, callee] = graph.edges[e];
+    if (caller == callee) continue;
+    auto [upper, lower] = dag[d++];
+    uint32_t span = vertex_layer[lower] - vertex_layer[upper];
+    if (span == 1) {
+      segments.emplace_back(upper, lower);
+      continue;
+    }
+    if (dummy_source.size() + span - 1 > dummy_budget) continue;
+    first_dummy[e] = vertex_layer.size();
+    dummy_count[e] = span - 1;
+    uint32_t previous = upper;
+    for (uint32_t k = 1; k < span; k++) {
+      uint32_t dummy = vertex_layer.size();
+      vertex_layer.push_back(vertex_layer[upper] + k);
+      dummy_source.push_back(upper);
+      segments.emplace_back(previous, dummy);
+      previous = dummy;
+    }
+    segments.emplace_back(previous, lower);
+  }
+  uint32_t vertex_count = vertex_layer.size();
+  Adjacency down, up;
+  down.build(vertex_count, segments, false);
+  up.build(vertex_count, segments, true);
+
+  // Initial order: DFS preorder, dummies next to their source. Nodes of
+  // the previous layout keep their relative order.
+  uint32_t layer_count = 0;
+  for (uint32_t layer : vertex_layer)
+    layer_count = std::max(layer_count, layer + 1);
+  std::vector<std::vector<uint32_t>> layers(layer_count);
+  for (uint32_t v = 0; v < vertex_count; v++)
+    layers[vertex_layer[v]].push_back(v);
+  auto initial_key = [&](uint32_t v) {
+    return v < node_count ? preorder[v] : preorder[dummy_source[v - node_count]];
+  };
+  std::vector<uint32_t> kept;
+  std::vector<size_t> kept_at;
+  for (auto& layer : layers) {
+    std::stable_sort(layer.begin(), layer.end(), [&](uint32_t a, uint32_t b) {
+      return initial_key(a) < initial_key(b);
+    });
+    if (graph.previous.empty()) continue;
+    kept.clear();
+    kept_at.clear();
+    for (size_t i = 0; i < layer.size(); i++) {
+      if (layer[i] >= node_count) continue;
+      kept.push_back(layer[i]);
+      kept_at.push_back(i);
+    }
+    std::stable_sort(kept.begin(), kept.end(), [&](uint32_t a, uint32_t b) {
+      return graph.previous[a].y < graph.previous[b].y;
+    });
+    for (size_t i = 0; i < kept.size(); i++) layer[kept_at[i]] = kept[i];
+  }
+  std::vector<uint32_t> pos(vertex_count);
+  for (const auto& layer : layers)
+    for (uint32_t i = 0; i < layer.size(); i++) pos[layer[i]] = i;
+
+  // Crossing reduction, down and up barycenter sweeps until they stop
+  // paying off. The best order seen wins.
+  size_t best = count_crossings(layers, down, pos);
+  layout.crossings_before = best;
+  auto best_layers = layers;
+  std::vector<float> key(vertex_count);
+  for (int sweep = 0, without_gain = 0; sweep < MAX_SWEEPS && best > 0;
+       sweep++) {
+    if (is_cancelled()) return std::nullopt;
+    for (size_t l = 1; l < layers.size(); l++)
+      sort_by_barycenter(layers[l], up, pos, key);
+    for (size_t l = layers.size() - 1; l-- > 0;)
+      sort_by_barycenter(layers[l], down, pos, key);
+    size_t crossings = count_crossings(layers, down, pos);
+    if (crossings < best) {
+      best = crossings;
+      best_layers = layers;
+      without_gain = 0;
+    } else if (++without_gain >= SWEEPS_WITHOUT_GAIN) {
+      break;
+    }
+  }
+  layers = std::move(best_layers);
+  layout.crossings = best;
+
+  // Coordinate assignment, starting packed and straightening edges towards
+  // both neighbouring layers.
+  std::vector<float> y(vertex_count, 0);
+  for (const auto& layer : layers)
+    for (size_t i = 0; i < layer.size(); i++) y[layer[i]] = i;
+  for (int pass = 0; pass < PLACEMENT_PASSES; pass++) {
+    if (is_cancelled()) return std::nullopt;
+    for (size_t l = 1; l < layers.size(); l++)
+      place_layer(layers[l], up, node_count, y);
+    for (size_t l = layers.size() - 1; l-- > 0;)
+      place_layer(layers[l], down, node_count, y);
+  }
+  float min_y = 0;
+  for (uint32_t v = 0; v < vertex_count; v++) min_y = std::min(min_y, y[v]);
+
+  layout.slots.resize(node_count);
+  for (uint32_t v = 0; v < node_count; v++)
+    layout.slots[v] = ImVec2(vertex_layer[v], y[v] - min_y);
+  layout.bend_offsets.resize(edge_count + 1, 0);
+  layout.bends.reserve(vertex_count - node_count);
+  for (size_t e = 0; e < edge_count; e++) {
+    for (uint32_t k = 0; k < dummy_count[e]; k++) {
+      uint32_t dummy = first_dummy[e] + k;
+      layout.bends.emplace_back(vertex_layer[dummy], y[dummy] - min_y);
+    }
+    layout.bend_offsets[e + 1] = layout.bends.size();
+  }
+  layout.milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  return layout;
+}
+
+LayoutWorker::LayoutWorker() : thread([this] { run(); }) {}
+
+LayoutWorker::~LayoutWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+    // Makes a layout in progress bail out early.
+    latest_generation++;
+  }
+  wake_up.notify_one();
+  thread.join();
+}
+
+unsigned long LayoutWorker::submit(LayoutGraph graph) {
+  unsigned long generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation = ++latest_generation;
+    graph.generation = generation;
+    pending = std::move(graph);
+    finished.reset();
+    busy = true;
+  }
+  wake_up.notify_one();
+  return generation;
+}
+
+std::optional<LayeredLayout> LayoutWorker::take_result() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::optional<LayeredLayout> result = std::move(finished);
+  finished.reset();
+  return result;
+}
+
+void LayoutWorker::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  finished_cv.wait(lock, [this] { return !busy; });
+}
+
+void LayoutWorker::set_on_result(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  on_result = std::move(callback);
+}
+
+void LayoutWorker::run() {
+  while (true) {
+    LayoutGraph graph;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake_up.wait(lock, [this] { return stop || pending; });
+      if (stop) return;
+      graph = std::move(*pending);
+      pending.reset();
+    }
+
+    auto layout = compute_layered_layout(graph, [this, &graph] {
+      return graph.generation !=
+             latest_generation.load(std::memory_order_relaxed);
+    });
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!layout || graph.generation != latest_generation) continue;
+    finished = std::move(layout);
+    busy = false;
+    auto callback = on_result;
+    lock.unlock();
+    finished_cv.notify_all();
+    if (callback) callback();
+  }
+}
+
+}  // namespace gui
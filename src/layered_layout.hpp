@@ -0,0 +1,88 @@
+#ifndef LAYERED_LAYOUT_HPP
+#define LAYERED_LAYOUT_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "imgui.h"
+
+namespace gui {
+
+// Input of a layered layout. Nodes are numbered 0 to node_count - 1.
+struct LayoutGraph {
+  unsigned long generation = 0;
+  uint32_t node_count = 0;
+  uint32_t root = 0;
+  // (caller, callee) pairs.
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  // Slots of the previous layout, parallel to the nodes. Only the order
+  // within a layer is taken over, so small changes keep the picture
+  // stable. Empty for a fresh layout.
+  std::vector<ImVec2> previous;
+};
+
+// Slots are (layer, position in the layer), in units of node distance.
+struct LayeredLayout {
+  unsigned long generation = 0;
+  std::vector<ImVec2> slots;
+  // Edges spanning several layers run through one bend per layer in
+  // between, ordered from the lower layer. Edge e has
+  // bends[bend_offsets[e], bend_offsets[e + 1]).
+  std::vector<uint32_t> bend_offsets;
+  std::vector<ImVec2> bends;
+  size_t reversed_edges = 0;
+  size_t crossings_before = 0;
+  size_t crossings = 0;
+  double milliseconds = 0;
+};
+
+// Sugiyama style layout: cycles are broken by reversing DFS back edges,
+// layers come from the longest path, long edges are split by dummy nodes,
+// crossings are reduced by barycenter sweeps and positions are straightened
+// by least squares placement within each layer. is_cancelled is checked
+// between the sweeps, a cancelled layout returns nothing.
+std::optional<LayeredLayout> compute_layered_layout(
+    const LayoutGraph& graph, const std::function<bool()>& is_cancelled);
+
+// Computes layouts on a dedicated thread. Only the newest graph matters:
+// submitting a new one abandons the one in progress.
+class LayoutWorker {
+ private:
+  std::mutex mutex;
+  std::condition_variable wake_up;
+  std::condition_variable finished_cv;
+  std::optional<LayoutGraph> pending;
+  std::optional<LayeredLayout> finished;
+  std::atomic<unsigned long> latest_generation{0};
+  bool busy = false;
+  bool stop = false;
+  std::function<void()> on_result;
+  std::thread thread;
+
+  void run();
+
+ public:
+  LayoutWorker();
+  ~LayoutWorker();
+  LayoutWorker(const LayoutWorker&) = delete;
+  LayoutWorker& operator=(const LayoutWorker&) = delete;
+
+  // Returns the generation the result will carry.
+  unsigned long submit(LayoutGraph graph);
+  // Returns the layout of the latest graph once, if it is ready.
+  std::optional<LayeredLayout> take_result();
+  // Blocks until the latest graph is laid out.
+  void wait();
+  // Called on the worker thread whenever take_result has something new.
+  void set_on_result(std::function<void()> callback);
+};
+
+}  // namespace gui
+
+#endif
@@ -18,10 +18,13 @@
 
 #include "clang_interface.h"
 #include "graph.hpp"
+#include "graph_index.h"
 #include "gui.hpp"
 #include "keyboard.hpp"
+#include "parse_worker.h"
+#include "project_indexer.h"
 
-int main(int, char**) {
+int main(int argc, char** argv) {
   gui::MainWindow main_window;
   ImGuiIO& io = ImGui::GetIO();
   io.Fonts->AddFontFromFileTTF("libs/imgui/misc/fonts/Cousine-Regular.ttf",
@@ -34,18 +37,88 @@ int main(int, char**) {
   gui::SourceCodePanel source_code_panel(
       io, main_window, &windows_toggle_menu.show_source_code_window);
 
-  clang_interface::ASTUnit ast_unit;
   clang_interface::CallGraph call_graph;
+  clang_interface::ParseWorker parse_worker;
+  std::unique_ptr<clang_interface::ProjectIndexer> project_indexer;
   gui::FunctionListFilteringWindow functions_filtering_window(
       windows_toggle_menu.show_function_list_window);
 
+  // Declared after the AST owners, so it is destroyed, and its thread joined,
+  // before any of them.
+  clang_interface::ASTDumpCache ast_dump_cache;
   gui::FunctionASTDumpWindow function_ast_dump_window(
-      windows_toggle_menu.show_ast_dump_window);
+      windows_toggle_menu.show_ast_dump_window, ast_dump_cache);
 
   gui::GraphGui graph(&io, &source_code_panel.Editor(),
                       windows_toggle_menu.show_callgraph_window);
+
+  // SourceExplorer [-p <build dir | compile_commands.json>] [-o <index>]
+  //                [-i <index>] [--idle-timeout <seconds>]
+  //                [--find-root <dir>]
+  std::string project_path, index_output, index_input;
+  std::filesystem::path find_root = std::filesystem::current_path();
+  for (int i = 1; i + 1 < argc; i++) {
+    if (std::strcmp(argv[i], "-p") == 0) project_path = argv[++i];
+    else if (std::strcmp(argv[i], "-o") == 0) index_output = argv[++i];
+    else if (std::strcmp(argv[i], "-i") == 0) index_input = argv[++i];
+    else if (std::strcmp(argv[i], "--idle-timeout") == 0)
+      main_window.idle_timeout = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--find-root") == 0) find_root = argv[++i];
+  }
+
+  // Crawls find_root the first time the finder is opened.
+  gui::PathIndex path_index;
+  gui::FileFinderWindow file_finder_window(
+      windows_toggle_menu.show_file_finder_window, path_index, find_root);
+  // A timeout of 0 starts with idle mode off, the checkbox turns it on with
+  // the default timeout.
+  bool idle_when_inactive = main_window.idle_timeout > 0;
+  double idle_timeout =
+      idle_when_inactive ? main_window.idle_timeout : 0.5;
+  windows_toggle_menu.idle_when_inactive = &idle_when_inactive;
+
+  // Wakes the frame loop when a background job has something to show.
+  parse_worker.SetOnResult(glfwPostEmptyEvent);
+  ast_dump_cache.SetOnResult(glfwPostEmptyEvent);
+  graph.set_on_layout(glfwPostEmptyEvent);
+  source_code_panel.SetOnDirectoryChange(glfwPostEmptyEvent);
+  path_index.set_on_change(glfwPostEmptyEvent);
+
+  gui::ProjectIndexWindow project_index_window(
+      windows_toggle_menu.show_project_window);
+  if (!project_path.empty()) {
+    std::string error_message;
+    project_indexer =
+        clang_interface::ProjectIndexer::Create(project_path, error_message);
+    if (project_indexer) {
+      project_indexer->SetOnProgress(glfwPostEmptyEvent);
+      project_indexer->Start();
+      project_index_window.SetIndexer(project_indexer.get());
+      windows_toggle_menu.show_project_window = true;
+    } else {
+      std::cerr << error_message << '\n';
+    }
+  }
+
+  if (!index_input.empty()) {
+    std::string error_message;
+    auto index = clang_interface::MappedIndex::Open(index_input, error_message);
+    if (index) {
+      ast_dump_cache.Reset(clang_interface::NoASTDump);
+      call_graph = clang_interface::CallGraphFromIndex(*index);
+      graph.BuildCallGraph(call_graph);
+      functions_filtering_window.SetFunctionsList(&call_graph.nodes);
+    } else {
+      std::cerr << error_message << '\n';
+    }
+  }
+
   while (!glfwWindowShouldClose(main_window.Window())) {
-    glfwPollEvents();
+    main_window.idle_timeout = idle_when_inactive ? idle_timeout : 0;
+    // The debounced parse below needs a frame about a second after the
+    // last edit, coloring a big file a few frames.
+    main_window.WaitEvents(source_code_panel.ShouldBuildCallgraph() ||
+                           source_code_panel.IsColorizing());
 
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -57,19 +130,68 @@ int main(int, char**) {
     if (io.KeyShift && io.KeyCtrl && io.KeysDown[keyboard::FKey]) {
       graph.focus_node(source_code_panel.Editor().GetSelectedText());
     }
+    if (io.KeyCtrl && io.KeysDown[keyboard::PKey]) {
+      windows_toggle_menu.show_file_finder_window = true;
+    }
 
     if (source_code_panel.SecondsSinceLastTextChange() == 1 &&
         source_code_panel.ShouldBuildCallgraph()) {
-      function_ast_dump_window.Clear();
       std::string compiler_include_dir =
           "-I" + source_code_panel.DirectoryOfLastOpenedFile().string();
-      auto new_ast_unit = clang_interface::BuildASTFromSource(
-          source_code_panel.SourceCode(), {compiler_include_dir});
-      call_graph = clang_interface::ExtractCallGraphFromAST(new_ast_unit);
-      ast_unit = std::move(new_ast_unit);
-      graph.BuildCallGraph(call_graph);
+      parse_worker.Submit(source_code_panel.Source(),
+                          {compiler_include_dir});
       source_code_panel.CallGraphBuilt();
+    }
+
+    if (auto parse_result = parse_worker.TakeResult()) {
+      function_ast_dump_window.Clear();
+      ast_dump_cache.Reset(
+          [&parse_worker, generation = parse_result->generation](
+              unsigned, const std::string& usr, const std::string& name) {
+            return parse_worker.DumpFunction(usr, name, generation);
+          });
+      call_graph = std::move(parse_result->call_graph);
+      graph.BuildCallGraph(call_graph);
       functions_filtering_window.SetFunctionsList(&call_graph.nodes);
+      windows_toggle_menu.last_parse_ms = parse_result->parse_ms;
+      windows_toggle_menu.last_extract_ms = parse_result->extract_ms;
+      windows_toggle_menu.last_parse_reparsed = parse_result->reparsed;
+      main_window.Redraw();
+    }
+    windows_toggle_menu.parsing = parse_worker.IsBusy();
+
+    if (project_indexer) {
+      if (auto project = project_indexer->TakeResult()) {
+        function_ast_dump_window.Clear();
+        ast_dump_cache.Reset(
+            [indexer = project_indexer.get()](unsigned id,
+                                              const std::string& usr,
+                                              const std::string& name) {
+              return indexer->DumpFunction(id, usr, name);
+            });
+        call_graph = std::move(*project);
+        graph.BuildCallGraph(call_graph);
+        main_window.Redraw();
+        functions_filtering_window.SetFunctionsList(&call_graph.nodes);
+        std::string error_message;
+        if (!index_output.empty() &&
+            !clang_interface::WriteIndex(call_graph, index_output,
+                                         error_message)) {
+          std::cerr << error_message << '\n';
+        }
+      }
+    }
+
+    if (windows_toggle_menu.show_project_window) {
+      project_index_window.Draw();
+    }
+
+    if (windows_toggle_menu.show_file_finder_window) {
+      file_finder_window.Draw();
+    }
+    if (auto file = file_finder_window.TakeChosenFile()) {
+      source_code_panel.OpenFile(*file);
+      windows_toggle_menu.show_source_code_window = true;
     }
 
     if (windows_toggle_menu.show_source_code_window) {
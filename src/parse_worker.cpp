@@ -0,0 +1,110 @@
+#include "parse_worker.h"
+#include "ast_dump_cache.h"
+
+#include <chrono>
+
+namespace clang_interface {
+
+ParseWorker::ParseWorker() : thread([this] { Run(); }) {}
+
+ParseWorker::~ParseWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+    // Makes an in-flight extraction bail out early.
+    latest_generation++;
+  }
+  wake_up.notify_one();
+  thread.join();
+}
+
+void ParseWorker::Submit(std::shared_ptr<const SourceBuffer> source,
+                         std::vector<std::string> compiler_args) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = Snapshot{++latest_generation, std::move(source),
+                       std::move(compiler_args)};
+    busy = true;
+  }
+  wake_up.notify_one();
+}
+
+void ParseWorker::SetOnResult(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  on_result = std::move(callback);
+}
+
+std::optional<ParseResult> ParseWorker::TakeResult() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!finished) {
+    return std::nullopt;
+  }
+  std::optional<ParseResult> result = std::move(finished);
+  finished.reset();
+  return result;
+}
+
+std::string ParseWorker::DumpFunction(const std::string& usr,
+                                      const std::string& name,
+                                      unsigned long generation) {
+  std::lock_guard<std::mutex> lock(ast_mutex);
+  if (generation != ast_generation) {
+    return "The source changed, waiting for the new call graph";
+  }
+  return DumpDecl(FindFunctionByUSR(parser.AST(), usr, name));
+}
+
+void ParseWorker::Run() {
+  while (true) {
+    Snapshot snapshot;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake_up.wait(lock, [this] { return stop || pending; });
+      if (stop) {
+        return;
+      }
+      snapshot = std::move(*pending);
+      pending.reset();
+    }
+
+    auto is_cancelled = [this, generation = snapshot.generation] {
+      return IsStale(generation);
+    };
+
+    // clang can not be interrupted while parsing, so staleness is checked
+    // between the phases and while matching call expressions.
+    std::unique_lock<std::mutex> ast_lock(ast_mutex);
+    auto start = std::chrono::steady_clock::now();
+    bool parsed =
+        parser.Parse(snapshot.source, std::move(snapshot.compiler_args));
+    ast_generation = parsed ? snapshot.generation : 0;
+    auto parsed_at = std::chrono::steady_clock::now();
+    if (is_cancelled()) {
+      continue;
+    }
+    CallGraph call_graph;
+    if (parsed) {
+      call_graph = ExtractCallGraphFromAST(parser.AST(), is_cancelled);
+    }
+    auto extracted_at = std::chrono::steady_clock::now();
+    ast_lock.unlock();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (IsStale(snapshot.generation)) {
+      continue;
+    }
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    finished = ParseResult{snapshot.generation, std::move(call_graph),
+                           milliseconds(parsed_at - start).count(),
+                           milliseconds(extracted_at - parsed_at).count(),
+                           parser.LastParseWasReparse()};
+    busy = false;
+    auto callback = on_result;
+    lock.unlock();
+    if (callback) {
+      callback();
+    }
+  }
+}
+
+};  // namespace clang_interface
@@ -0,0 +1,81 @@
+#ifndef PARSE_WORKER_H
+#define PARSE_WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "clang_interface.h"
+#include "incremental_parser.h"
+#include "source_buffer.h"
+
+namespace clang_interface {
+
+struct ParseResult {
+  unsigned long generation;
+  CallGraph call_graph;
+  double parse_ms;
+  double extract_ms;
+  // Whether the precompiled preamble of the previous parse was reused.
+  bool reparsed;
+};
+
+// Builds the AST and call graph of source snapshots on a dedicated thread.
+// Only the newest snapshot matters: submitting a new one makes the worker
+// abandon whatever it is currently parsing as soon as it can.
+//
+// The AST lives on the worker and is reparsed in place for every snapshot;
+// it is the one AST kept alive, since the precompiled preamble depends on it.
+class ParseWorker {
+ private:
+  struct Snapshot {
+    unsigned long generation;
+    std::shared_ptr<const SourceBuffer> source;
+    std::vector<std::string> compiler_args;
+  };
+
+  std::mutex mutex;
+  std::condition_variable wake_up;
+  std::optional<Snapshot> pending;
+  std::optional<ParseResult> finished;
+  std::atomic<unsigned long> latest_generation{0};
+  std::atomic<bool> busy{false};
+  bool stop = false;
+  std::function<void()> on_result;
+  // Guards parser against dumps requested while a snapshot is parsed.
+  std::mutex ast_mutex;
+  IncrementalParser parser;
+  unsigned long ast_generation = 0;
+  std::thread thread;
+
+  void Run();
+  bool IsStale(unsigned long generation) const {
+    return generation != latest_generation.load(std::memory_order_relaxed);
+  }
+
+ public:
+  ParseWorker();
+  ~ParseWorker();
+  ParseWorker(const ParseWorker&) = delete;
+  ParseWorker& operator=(const ParseWorker&) = delete;
+
+  void Submit(std::shared_ptr<const SourceBuffer> source,
+              std::vector<std::string> compiler_args = {});
+  // Returns the result of the latest snapshot once, if it is ready.
+  std::optional<ParseResult> TakeResult();
+  bool IsBusy() const { return busy.load(std::memory_order_relaxed); }
+  // Called on the worker thread whenever TakeResult has something new.
+  void SetOnResult(std::function<void()> callback);
+  // Dumps the function with the given USR and name if the live AST still is
+  // the one of snapshot generation. Meant to back an ASTDumpCache::Dumper.
+  std::string DumpFunction(const std::string& usr, const std::string& name,
+                           unsigned long generation);
+};
+
+};  // namespace clang_interface
+
+#endif  // PARSE_WORKER_H
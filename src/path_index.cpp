@@ -0,0 +1,713 @@
+#include "path_index.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+#include "thread_pool.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace gui {
+
+namespace {
+
+// The overlay is encoded into the paths once it holds this many changes, or
+// a quarter of the paths.
+const size_t OVERLAY_LIMIT = 4096;
+const auto PUBLISH_INTERVAL = std::chrono::milliseconds(250);
+const size_t MIN_BLOCKS_PER_TASK = 64;
+
+const int SCORE_MATCH = 16;
+const int BONUS_BOUNDARY = 8;
+const int BONUS_CAMEL_CASE = 6;
+const int BONUS_CONSECUTIVE = 4;
+const int BONUS_FILE_NAME = 16;
+const int PENALTY_GAP_START = 3;
+const int PENALTY_GAP_EXTENSION = 1;
+
+char fold(char c) { return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c; }
+
+// Without branches, so the compiler vectorizes it.
+void fold(const char* in, char* out, size_t length) {
+  for (size_t i = 0; i < length; i++)
+    out[i] = in[i] + (uint8_t(in[i] - 'A') < 26 ? 'a' - 'A' : 0);
+}
+
+// One bit per letter and a few for the rest. A path can only match a query
+// whose bits it all has, which rules most paths out without looking at
+// them.
+uint32_t char_mask(char c) {
+  c = fold(c);
+  if (c >= 'a' && c <= 'z') return 1u << (c - 'a');
+  if (c >= '0' && c <= '9') return 1u << 26;
+  switch (c) {
+    case '_':
+      return 1u << 27;
+    case '.':
+      return 1u << 28;
+    case '/':
+      return 1u << 29;
+    case '-':
+      return 1u << 30;
+  }
+  return 1u << 31;
+}
+
+uint32_t string_mask(std::string_view string) {
+  uint32_t mask = 0;
+  for (char c : string) mask |= char_mask(c);
+  return mask;
+}
+
+bool is_boundary(char c) {
+  return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+// Greedy forward match of a folded query over a folded path: the first
+// occurrence of each query character after the one before. Positions
+// inside a prefix only depend on the prefix, so the scan of a path that
+// shares one with the path scanned before resumes from there.
+struct ForwardScan {
+  std::string_view query;
+  std::vector<uint32_t> positions;
+  size_t matched = 0;
+
+  explicit ForwardScan(std::string_view query)
+      : query(query), positions(query.size()) {}
+  // Drops the positions past the first valid_prefix characters.
+  void keep(size_t valid_prefix) {
+    while (matched > 0 && positions[matched - 1] >= valid_prefix) matched--;
+  }
+  bool run(std::string_view folded) {
+    size_t from = matched > 0 ? positions[matched - 1] + 1 : 0;
+    while (matched < query.size()) {
+      if (from >= folded.size()) return false;
+      const void* hit = std::memchr(folded.data() + from, query[matched],
+                                    folded.size() - from);
+      if (hit == nullptr) return false;
+      positions[matched] = static_cast<const char*>(hit) - folded.data();
+      from = positions[matched++] + 1;
+    }
+    return true;
+  }
+};
+
+// Takes the shortest window of path that ends where the forward scan
+// ended, like fzf's v1 algorithm, and scores it: matches at word starts and
+// runs of matches count more, gaps count against, and so does a match that
+// does not lie in the file name, which starts at name_start.
+int score_match(std::string_view path, std::string_view folded,
+                std::string_view query, size_t end, size_t name_start) {
+  size_t q = query.size(), start = end;
+  for (size_t i = end + 1; i-- > 0;) {
+    if (folded[i] == query[q - 1] && --q == 0) {
+      start = i;
+      break;
+    }
+  }
+
+  int score = 0;
+  bool in_gap = false, previous_matched = false;
+  for (size_t i = start; i <= end && q < query.size(); i++) {
+    if (folded[i] != query[q]) {
+      score -= in_gap ? PENALTY_GAP_EXTENSION : PENALTY_GAP_START;
+      in_gap = true;
+      previous_matched = false;
+      continue;
+    }
+    score += SCORE_MATCH;
+    char previous = i > 0 ? path[i - 1] : '/';
+    if (is_boundary(previous))
+      score += BONUS_BOUNDARY;
+    else if (previous >= 'a' && previous <= 'z' && path[i] >= 'A' &&
+             path[i] <= 'Z')
+      score += BONUS_CAMEL_CASE;
+    if (previous_matched) score += BONUS_CONSECUTIVE;
+    previous_matched = true;
+    in_gap = false;
+    q++;
+  }
+  if (start >= name_start) score += BONUS_FILE_NAME;
+  return score;
+}
+
+// Query is folded. -1 when there is no match.
+int fuzzy_score(std::string_view path, std::string_view query) {
+  std::string folded(path.size(), '\0');
+  fold(path.data(), folded.data(), path.size());
+  ForwardScan scan(query);
+  if (!scan.run(folded)) return -1;
+  size_t slash = path.rfind('/');
+  return score_match(path, folded, query, scan.positions.back(),
+                     slash == std::string_view::npos ? 0 : slash + 1);
+}
+
+// Query characters in order, not necessarily next to each other.
+bool is_subsequence(std::string_view small, std::string_view big) {
+  size_t i = 0;
+  for (char c : big)
+    if (i < small.size() && small[i] == c) i++;
+  return i == small.size();
+}
+
+void put_varint(std::string& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(char(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(char(value));
+}
+
+uint32_t get_varint(const char*& in) {
+  uint32_t value = 0;
+  int shift = 0;
+  while (uint8_t(*in) & 0x80) {
+    value |= uint32_t(uint8_t(*in++) & 0x7f) << shift;
+    shift += 7;
+  }
+  return value | uint32_t(uint8_t(*in++)) << shift;
+}
+
+// Paths must be sorted and unique.
+std::shared_ptr<const PathIndex::Paths> encode(
+    const std::vector<std::string>& sorted) {
+  auto paths = std::make_shared<PathIndex::Paths>();
+  paths->masks.reserve(sorted.size());
+  for (size_t i = 0; i < sorted.size(); i++) {
+    const std::string& path = sorted[i];
+    size_t shared = 0;
+    if (i % PathIndex::Paths::BLOCK_SIZE == 0) {
+      paths->block_offsets.push_back(paths->data.size());
+    } else {
+      const std::string& previous = sorted[i - 1];
+      size_t limit = std::min(previous.size(), path.size());
+      while (shared < limit && previous[shared] == path[shared]) shared++;
+    }
+    put_varint(paths->data, shared);
+    put_varint(paths->data, path.size() - shared);
+    paths->data.append(path, shared, std::string::npos);
+    paths->masks.push_back(string_mask(path));
+  }
+  paths->data.shrink_to_fit();
+  paths->count = sorted.size();
+  return paths;
+}
+
+}  // namespace
+
+template <typename F>
+void PathIndex::Paths::for_each_in_block(size_t block, std::string& buffer,
+                                         F f) const {
+  const char* in = data.data() + block_offsets[block];
+  size_t first = block * BLOCK_SIZE;
+  size_t last = std::min(count, first + BLOCK_SIZE);
+  for (size_t i = first; i < last; i++) {
+    uint32_t shared = get_varint(in);
+    uint32_t length = get_varint(in);
+    buffer.resize(shared);
+    buffer.append(in, length);
+    in += length;
+    f(i, std::string_view(buffer), shared);
+  }
+}
+
+std::string PathIndex::Paths::at(size_t index) const {
+  std::string buffer, path;
+  for_each_in_block(index / BLOCK_SIZE, buffer,
+                    [&](size_t i, std::string_view decoded, size_t) {
+                      if (i == index) path = decoded;
+                    });
+  return path;
+}
+
+bool PathIndex::Paths::contains(const std::string& path) const {
+  if (count == 0) return false;
+  // The first path of a block is stored whole.
+  auto first_path = [this](size_t block) {
+    const char* in = data.data() + block_offsets[block];
+    get_varint(in);
+    uint32_t length = get_varint(in);
+    return std::string_view(in, length);
+  };
+  size_t low = 0, high = block_offsets.size();
+  while (high - low > 1) {
+    size_t middle = (low + high) / 2;
+    if (first_path(middle) <= path)
+      low = middle;
+    else
+      high = middle;
+  }
+  bool found = false;
+  std::string buffer;
+  for_each_in_block(low, buffer,
+                    [&](size_t, std::string_view decoded, size_t) {
+                      found |= decoded == path;
+                    });
+  return found;
+}
+
+std::vector<std::string> PathIndex::Paths::decode() const {
+  std::vector<std::string> paths;
+  paths.reserve(count);
+  std::string buffer;
+  for (size_t block = 0; block < block_offsets.size(); block++)
+    for_each_in_block(block, buffer,
+                      [&](size_t, std::string_view path, size_t) {
+                        paths.emplace_back(path);
+                      });
+  return paths;
+}
+
+PathIndex::PathIndex(unsigned threads)
+    : threads(std::max(1u, threads)),
+      base(std::make_shared<const Paths>()) {}
+
+PathIndex::~PathIndex() {
+  stop = true;
+  if (thread.joinable()) {
+    wake();
+    thread.join();
+  }
+  for (int fd : {inotify_fd, wake_fds[0], wake_fds[1]})
+    if (fd >= 0) close(fd);
+}
+
+void PathIndex::start(const fs::path& new_root) {
+  if (started()) return;
+  std::error_code error;
+  root = fs::canonical(new_root, error);
+  if (error) root = fs::absolute(new_root);
+#ifdef __linux__
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  if (pipe(wake_fds) == 0) {
+    fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+  } else {
+    // Nothing could wake the thread from poll to stop it, so changes are
+    // not followed, as without inotify. The crawl checks stop itself.
+    wake_fds[0] = wake_fds[1] = -1;
+    if (inotify_fd >= 0) close(inotify_fd);
+    inotify_fd = -1;
+  }
+  thread = std::thread([this] { run(); });
+}
+
+void PathIndex::assign(std::vector<std::string> paths) {
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+  base = encode(paths);
+  added.clear();
+  removed.clear();
+  publish(false);
+}
+
+PathIndex::Stats PathIndex::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return current_stats;
+}
+
+void PathIndex::set_on_change(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  on_change = std::move(callback);
+}
+
+bool PathIndex::is_source_file(std::string_view path) {
+  size_t dot = path.rfind('.');
+  if (dot == std::string_view::npos) return false;
+  std::string_view extension = path.substr(dot);
+  return extension == ".cpp" || extension == ".hpp" || extension == ".h" ||
+         extension == ".cc" || extension == ".c";
+}
+
+void PathIndex::wake() {
+  char byte = 0;
+  if (write(wake_fds[1], &byte, 1) < 0) {
+    // Full, the index thread wakes up anyway.
+  }
+}
+
+void PathIndex::run() {
+  auto crawl_start = std::chrono::steady_clock::now();
+  crawl("", true);
+  crawl_ms = std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - crawl_start)
+                 .count();
+  publish(false);
+
+  while (!stop && inotify_fd >= 0) {
+    pollfd fds[2] = {{wake_fds[0], POLLIN, 0}, {inotify_fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0 && errno != EINTR) return;
+    if (fds[1].revents & POLLIN) read_events();
+  }
+}
+
+void PathIndex::crawl(const std::string& directory, bool fresh) {
+  auto last_publish = std::chrono::steady_clock::now();
+  std::vector<std::string> pending{directory};
+  while (!pending.empty() && !stop) {
+    std::string relative = std::move(pending.back());
+    pending.pop_back();
+    // Before listing, so nothing that changes meanwhile is missed.
+    watch(relative);
+
+    std::error_code error;
+    fs::directory_iterator it(relative.empty() ? root : root / relative,
+                              fs::directory_options::skip_permission_denied,
+                              error);
+    for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+      std::string name = it->path().filename().string();
+      std::string path = relative.empty() ? name : relative + '/' + name;
+      std::error_code type_error;
+      if (it->is_directory(type_error)) {
+        // Hidden directories (.git, caches) are skipped, and links, which
+        // can loop.
+        if (name[0] == '.' || it->is_symlink(type_error)) continue;
+        pending.push_back(std::move(path));
+      } else if (is_source_file(name)) {
+        if (fresh)
+          added.insert(std::move(path));
+        else
+          add(path);
+      }
+    }
+
+    if (fresh &&
+        std::chrono::steady_clock::now() - last_publish > PUBLISH_INTERVAL) {
+      publish(true);
+      last_publish = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+void PathIndex::watch(const std::string& directory) {
+#ifdef __linux__
+  if (inotify_fd >= 0) {
+    fs::path path = directory.empty() ? root : root / directory;
+    int wd = inotify_add_watch(inotify_fd, path.c_str(),
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_ONLYDIR);
+    if (wd >= 0) {
+      watches[wd] = directory;
+      return;
+    }
+  }
+#endif
+  unwatched++;
+}
+
+void PathIndex::read_events() {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[4096];
+  bool changed = false, overflow = false;
+  ssize_t length;
+  while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+    for (char* next = buffer; next < buffer + length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(next);
+      next += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        overflow = true;
+        continue;
+      }
+      auto watch = watches.find(event->wd);
+      if (watch == watches.end()) continue;
+      if (event->mask & IN_IGNORED) {
+        watches.erase(watch);
+        continue;
+      }
+      if (event->len == 0) continue;
+      std::string name = event->name;
+      std::string path =
+          watch->second.empty() ? name : watch->second + '/' + name;
+      bool appeared = event->mask & (IN_CREATE | IN_MOVED_TO);
+      if (event->mask & IN_ISDIR) {
+        if (name[0] == '.') continue;
+        if (appeared)
+          crawl(path, false);
+        else
+          remove_directory(path);
+        changed = true;
+      } else if (is_source_file(name)) {
+        if (appeared)
+          add(path);
+        else
+          remove(path);
+        changed = true;
+      }
+    }
+  }
+  if (overflow) {
+    // Changes were lost, start over.
+    reset();
+    crawl("", true);
+  }
+  if (changed || overflow) publish(false);
+#endif
+}
+
+void PathIndex::add(const std::string& path) {
+  if (removed.erase(path) || base->contains(path)) return;
+  added.insert(path);
+}
+
+void PathIndex::remove(const std::string& path) {
+  if (added.erase(path)) return;
+  if (base->contains(path)) removed.insert(path);
+}
+
+void PathIndex::remove_directory(const std::string& directory) {
+  std::string prefix = directory + '/';
+  auto below = [&prefix](std::string_view path) {
+    return path.compare(0, prefix.size(), prefix) == 0;
+  };
+  for (auto it = added.lower_bound(prefix);
+       it != added.end() && below(*it);)
+    it = added.erase(it);
+  // Paths are sorted, the directory's are one run.
+  std::string buffer;
+  bool past = false;
+  for (size_t block = 0; block < base->block_offsets.size() && !past;
+       block++) {
+    base->for_each_in_block(block, buffer,
+                            [&](size_t, std::string_view path, size_t) {
+                              if (below(path))
+                                removed.emplace(path);
+                              else if (path > prefix)
+                                past = true;
+                            });
+  }
+#ifdef __linux__
+  for (auto it = watches.begin(); it != watches.end();) {
+    if (it->second == directory || below(it->second)) {
+      inotify_rm_watch(inotify_fd, it->first);
+      it = watches.erase(it);
+    } else {
+      ++it;
+    }
+  }
+#endif
+}
+
+void PathIndex::reset() {
+#ifdef __linux__
+  for (const auto& [wd, directory] : watches)
+    inotify_rm_watch(inotify_fd, wd);
+#endif
+  watches.clear();
+  base = std::make_shared<const Paths>();
+  added.clear();
+  removed.clear();
+  unwatched = 0;
+}
+
+void PathIndex::compact() {
+  std::vector<std::string> kept = base->decode();
+  if (!removed.empty()) {
+    kept.erase(std::remove_if(kept.begin(), kept.end(),
+                              [this](const std::string& path) {
+                                return removed.count(path) > 0;
+                              }),
+               kept.end());
+  }
+  std::vector<std::string> paths;
+  paths.reserve(kept.size() + added.size());
+  std::merge(std::make_move_iterator(kept.begin()),
+             std::make_move_iterator(kept.end()), added.begin(), added.end(),
+             std::back_inserter(paths));
+  base = encode(paths);
+  added.clear();
+  removed.clear();
+}
+
+void PathIndex::publish(bool crawling) {
+  if (added.size() + removed.size() > std::max(OVERLAY_LIMIT, base->count / 4))
+    compact();
+  auto next = std::make_shared<Snapshot>();
+  next->base = base;
+  next->added.assign(added.begin(), added.end());
+  for (const auto& path : next->added)
+    next->added_masks.push_back(string_mask(path));
+  next->removed = removed;
+
+  Stats stats;
+  stats.version = ++version;
+  stats.files = base->count - removed.size() + added.size();
+  stats.directories = watches.size() + unwatched;
+  stats.bytes = base->data.capacity() + base->masks.capacity() * 4 +
+                base->block_offsets.capacity() * 4;
+  stats.crawl_ms = crawl_ms;
+  stats.crawling = crawling;
+  stats.unwatched = unwatched;
+
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = std::move(next);
+    current_stats = stats;
+    callback = on_change;
+  }
+  if (callback) callback();
+}
+
+std::vector<PathIndex::Match> PathIndex::find(const std::string& query,
+                                              size_t limit) {
+  std::shared_ptr<const Snapshot> current;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = snapshot;
+  }
+  std::vector<Match> matches;
+  if (!current || limit == 0) return matches;
+  const Paths& paths = *current->base;
+  std::string folded;
+  for (char c : query)
+    if (c != ' ') folded.push_back(fold(c));
+
+  // Paths that extend the previous query only match where it matched.
+  std::vector<uint32_t> blocks;
+  if (current == last_snapshot && !last_query.empty() &&
+      is_subsequence(last_query, folded)) {
+    blocks = std::move(last_blocks);
+  } else {
+    blocks.resize(paths.block_offsets.size());
+    std::iota(blocks.begin(), blocks.end(), 0);
+  }
+  last_snapshot = current;
+  last_query = folded;
+  last_blocks.clear();
+
+  auto is_removed = [&current](std::string_view path) {
+    return !current->removed.empty() &&
+           current->removed.count(std::string(path)) > 0;
+  };
+
+  if (folded.empty()) {
+    // Everything matches, in sorted order.
+    std::string buffer;
+    for (size_t block = 0;
+         block < paths.block_offsets.size() && matches.size() < limit;
+         block++) {
+      paths.for_each_in_block(
+          block, buffer, [&](size_t, std::string_view path, size_t) {
+            if (matches.size() < limit && !is_removed(path))
+              matches.push_back({std::string(path), 0});
+          });
+    }
+    for (const auto& path : current->added) {
+      if (matches.size() == limit) break;
+      matches.push_back({path, 0});
+    }
+    return matches;
+  }
+
+  // Better first: higher score, then shorter, then sorted order. Added
+  // paths come after the encoded ones.
+  struct Candidate {
+    int score;
+    uint32_t length;
+    uint32_t index;
+  };
+  auto better = [](const Candidate& a, const Candidate& b) {
+    if (a.score != b.score) return a.score > b.score;
+    if (a.length != b.length) return a.length < b.length;
+    return a.index < b.index;
+  };
+  // Heaps of the best limit candidates, the worst on top.
+  auto offer = [&](std::vector<Candidate>& heap, const Candidate& candidate) {
+    if (heap.size() < limit) {
+      heap.push_back(candidate);
+      std::push_heap(heap.begin(), heap.end(), better);
+    } else if (better(candidate, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), better);
+      heap.back() = candidate;
+      std::push_heap(heap.begin(), heap.end(), better);
+    }
+  };
+  uint32_t query_mask = string_mask(folded);
+
+  if (!pool) pool = std::make_unique<ThreadPool>(threads);
+  size_t chunk = std::max<size_t>(
+      MIN_BLOCKS_PER_TASK,
+      (blocks.size() + pool->Size() * 4 - 1) / (pool->Size() * 4));
+  size_t task_count = (blocks.size() + chunk - 1) / chunk;
+  std::vector<std::vector<Candidate>> heaps(task_count);
+  std::vector<std::vector<uint32_t>> matched_blocks(task_count);
+  for (size_t task = 0; task < task_count; task++) {
+    pool->Submit([&, task](unsigned) {
+      std::string buffer, folded_path;
+      ForwardScan scan(folded);
+      size_t last = std::min(blocks.size(), (task + 1) * chunk);
+      for (size_t b = task * chunk; b < last; b++) {
+        uint32_t block = blocks[b];
+        size_t first_path = block * Paths::BLOCK_SIZE;
+        size_t last_path =
+            std::min(paths.count, first_path + Paths::BLOCK_SIZE);
+        // Most blocks are ruled out by their masks alone.
+        bool possible = false;
+        for (size_t i = first_path; i < last_path && !possible; i++)
+          possible = (paths.masks[i] & query_mask) == query_mask;
+        if (!possible) continue;
+        bool matched = false;
+        // How much of the path scanned last the paths since then share.
+        size_t valid_prefix = 0;
+        paths.for_each_in_block(
+            block, buffer,
+            [&](size_t i, std::string_view path, size_t shared) {
+              // Only the part that differs from the previous path is folded.
+              folded_path.resize(path.size());
+              fold(path.data() + shared, &folded_path[shared],
+                   path.size() - shared);
+              size_t slash = path.rfind('/');
+              size_t name_start =
+                  slash == std::string_view::npos ? 0 : slash + 1;
+              valid_prefix = std::min(valid_prefix, shared);
+              if ((paths.masks[i] & query_mask) != query_mask) return;
+              scan.keep(valid_prefix);
+              valid_prefix = path.size();
+              if (!scan.run(folded_path)) return;
+              int score = score_match(path, folded_path, folded,
+                                      scan.positions.back(), name_start);
+              matched = true;
+              if (is_removed(path)) return;
+              offer(heaps[task], {score, uint32_t(path.size()), uint32_t(i)});
+            });
+        if (matched) matched_blocks[task].push_back(block);
+      }
+    });
+  }
+  pool->Wait();
+
+  std::vector<Candidate> best;
+  for (size_t i = 0; i < current->added.size(); i++) {
+    if ((current->added_masks[i] & query_mask) != query_mask) continue;
+    const std::string& path = current->added[i];
+    int score = fuzzy_score(path, folded);
+    if (score >= 0)
+      offer(best, {score, uint32_t(path.size()), uint32_t(paths.count + i)});
+  }
+  for (size_t task = 0; task < task_count; task++) {
+    best.insert(best.end(), heaps[task].begin(), heaps[task].end());
+    last_blocks.insert(last_blocks.end(), matched_blocks[task].begin(),
+                       matched_blocks[task].end());
+  }
+  std::sort(best.begin(), best.end(), better);
+  if (best.size() > limit) best.resize(limit);
+
+  matches.reserve(best.size());
+  for (const auto& candidate : best) {
+    matches.push_back({candidate.index < paths.count
+                           ? paths.at(candidate.index)
+                           : current->added[candidate.index - paths.count],
+                       candidate.score});
+  }
+  return matches;
+}
+
+}  // namespace gui
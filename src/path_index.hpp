@@ -0,0 +1,146 @@
+#ifndef PATH_INDEX_HPP
+#define PATH_INDEX_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class ThreadPool;
+
+namespace gui {
+
+namespace fs = std::filesystem;
+
+// Source files below a root, for the fuzzy file finder. A thread crawls the
+// root, then follows changes through inotify on Linux. Paths are relative
+// to the root and sorted, and kept front coded: each one stores only what
+// differs from the one before. Changes go to a small overlay until it is
+// worth encoding everything again.
+//
+// find scores every path on a thread pool and returns the best matches. A
+// query that extends the previous one only looks at the blocks of paths
+// that matched before.
+class PathIndex {
+ public:
+  struct Match {
+    std::string path;
+    int score;
+  };
+  struct Stats {
+    // Bumped whenever the paths change.
+    unsigned long version = 0;
+    size_t files = 0;
+    size_t directories = 0;
+    size_t bytes = 0;
+    double crawl_ms = 0;
+    bool crawling = false;
+    // Directories whose changes are not followed, e.g. past the inotify
+    // watch limit.
+    size_t unwatched = 0;
+  };
+
+  // Immutable front coded paths. Every BLOCK_SIZE paths the coding
+  // restarts with a whole path, so blocks decode independently.
+  struct Paths {
+    static constexpr size_t BLOCK_SIZE = 32;
+    std::string data;
+    std::vector<uint32_t> block_offsets;
+    // Characters each path contains, see char_mask.
+    std::vector<uint32_t> masks;
+    size_t count = 0;
+
+    // Calls f(index, path) for the paths of block.
+    template <typename F>
+    void for_each_in_block(size_t block, std::string& buffer, F f) const;
+    std::string at(size_t index) const;
+    bool contains(const std::string& path) const;
+    std::vector<std::string> decode() const;
+  };
+
+ private:
+  struct Snapshot {
+    std::shared_ptr<const Paths> base;
+    std::vector<std::string> added;
+    std::vector<uint32_t> added_masks;
+    std::unordered_set<std::string> removed;
+  };
+
+  fs::path root;
+  unsigned threads;
+  std::unique_ptr<ThreadPool> pool;
+
+  mutable std::mutex mutex;
+  std::shared_ptr<const Snapshot> snapshot;
+  Stats current_stats;
+  std::function<void()> on_change;
+  std::atomic<bool> stop{false};
+  std::thread thread;
+
+  // Only used by the index thread.
+  std::shared_ptr<const Paths> base;
+  std::set<std::string> added;
+  std::unordered_set<std::string> removed;
+  int inotify_fd = -1;
+  int wake_fds[2] = {-1, -1};
+  std::unordered_map<int, std::string> watches;
+  size_t unwatched = 0;
+  unsigned long version = 0;
+  double crawl_ms = 0;
+
+  // Only used by find, on the caller's thread.
+  std::shared_ptr<const Snapshot> last_snapshot;
+  std::string last_query;
+  std::vector<uint32_t> last_blocks;
+
+  void run();
+  void wake();
+  // A fresh crawl starts from an empty index: paths go to the overlay
+  // unchecked, and progress is published as it goes.
+  void crawl(const std::string& directory, bool fresh);
+  void watch(const std::string& directory);
+  void read_events();
+  void add(const std::string& path);
+  void remove(const std::string& path);
+  void remove_directory(const std::string& directory);
+  void reset();
+  void compact();
+  void publish(bool crawling);
+
+ public:
+  explicit PathIndex(unsigned threads = std::thread::hardware_concurrency());
+  ~PathIndex();
+  PathIndex(const PathIndex&) = delete;
+  PathIndex& operator=(const PathIndex&) = delete;
+
+  // Crawls new_root on the index thread and then keeps up with its changes.
+  // Only the first call does anything.
+  void start(const fs::path& new_root);
+  bool started() const { return thread.joinable(); }
+  // Replaces the index with paths, relative to root, without crawling. Not
+  // for an index that was started.
+  void assign(std::vector<std::string> paths);
+  const fs::path& root_path() const { return root; }
+  Stats stats() const;
+  // Called on the index thread whenever the paths changed.
+  void set_on_change(std::function<void()> callback);
+
+  // Best limit matches of query, best first. Called from one thread.
+  std::vector<Match> find(const std::string& query, size_t limit);
+
+  // Extensions of the source files the index keeps, as in FileBrowser.
+  static bool is_source_file(std::string_view path);
+};
+
+}  // namespace gui
+
+#endif
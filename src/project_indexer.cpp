@@ -0,0 +1,320 @@
+#include "project_indexer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include "clang/Tooling/JSONCompilationDatabase.h"
+#include "ast_dump_cache.h"
+#include "thread_pool.h"
+
+namespace clang_interface {
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+bool ReadFile(const std::string& file_name, std::string& content) {
+  std::ifstream in(file_name);
+  if (!in.is_open()) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+}  // namespace
+
+FunctionDecl* ShardedNodeTable::Merge(std::unique_ptr<FunctionDecl>& node,
+                                      unsigned translation_unit) {
+  const std::string& usr = node->USR();
+  auto& shard = shards[std::hash<std::string>{}(usr) % SHARDS];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (!usr.empty()) {
+    auto existing = shard.by_usr.find(usr);
+    if (existing != shard.by_usr.end()) {
+      FunctionDecl* merged = shard.nodes[existing->second].get();
+      // A unit that only includes the prototype may have come first.
+      if (PrefersDeclaration(*node, *merged)) {
+        unsigned id = merged->ID();
+        *merged = std::move(*node);
+        merged->SetID(id);
+        shard.translation_units[existing->second] = translation_unit;
+      }
+      return merged;
+    }
+  }
+  node->SetID(next_id++);
+  FunctionDecl* merged = node.get();
+  shard.nodes.emplace_back(std::move(node));
+  shard.translation_units.push_back(translation_unit);
+  // Functions without a USR can not be matched across translation units,
+  // each of them stays a node of its own.
+  if (!usr.empty()) {
+    shard.by_usr.emplace(merged->USR(), shard.nodes.size() - 1);
+  }
+  return merged;
+}
+
+CallGraph::NodesList ShardedNodeTable::TakeNodes(
+    std::vector<unsigned>& translation_units) {
+  CallGraph::NodesList nodes;
+  translation_units.assign(next_id, 0);
+  for (auto& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (size_t i = 0; i < shard.nodes.size(); i++) {
+      translation_units[shard.nodes[i]->ID()] = shard.translation_units[i];
+      nodes.emplace_back(std::move(shard.nodes[i]));
+    }
+    shard.nodes.clear();
+    shard.translation_units.clear();
+    shard.by_usr.clear();
+  }
+  // Shard order is arbitrary, ids follow the order of discovery.
+  std::sort(nodes.begin(), nodes.end(),
+            [](const auto& a, const auto& b) { return a->ID() < b->ID(); });
+  return nodes;
+}
+
+std::filesystem::path SourcePath(const clang::tooling::CompileCommand& command,
+                                 const std::string& file) {
+  return (std::filesystem::path(command.Directory) / file).lexically_normal();
+}
+
+std::vector<std::string> CompilerArgsFromCommand(
+    const clang::tooling::CompileCommand& command) {
+  std::vector<std::string> args;
+  const auto& line = command.CommandLine;
+  // The database may name the file absolute and the command relative, or
+  // the other way around.
+  const auto source_path = SourcePath(command, command.Filename);
+  // The first argument is the compiler itself, buildASTFromCodeWithArgs adds
+  // its own driver name, -fsyntax-only and the file name.
+  for (size_t i = 1; i < line.size(); i++) {
+    const std::string& arg = line[i];
+    if (arg == "-c") {
+      continue;
+    }
+    if (arg == "-o") {
+      i++;
+      continue;
+    }
+    // -o<file>, but not the driver flags that only start with -o, like
+    // -objcmt-* and -object.
+    if (arg.compare(0, 2, "-o") == 0 && arg.compare(0, 4, "-obj") != 0) {
+      continue;
+    }
+    if (arg[0] != '-' && SourcePath(command, arg) == source_path) {
+      continue;
+    }
+    args.push_back(arg);
+  }
+  // Relative include paths in the database are relative to the directory
+  // the command ran in, not to ours.
+  args.push_back("-working-directory=" + command.Directory);
+  return args;
+}
+
+std::unique_ptr<clang::tooling::CompilationDatabase> LoadCompilationDatabase(
+    const std::string& path, std::string& error_message) {
+  std::unique_ptr<clang::tooling::CompilationDatabase> database;
+  if (llvm::StringRef(path).endswith(".json")) {
+    database = clang::tooling::JSONCompilationDatabase::loadFromFile(
+        path, error_message, clang::tooling::JSONCommandLineSyntax::AutoDetect);
+  } else {
+    database =
+        clang::tooling::CompilationDatabase::loadFromDirectory(path, error_message);
+  }
+  return database;
+}
+
+ASTUnit BuildASTFromCommand(const clang::tooling::CompileCommand& command,
+                            TranslationUnitReport& report) {
+  report.file = SourcePath(command, command.Filename).string();
+
+  std::string source;
+  if (!ReadFile(report.file, source)) {
+    report.error = "can not read file";
+    return ASTUnit();
+  }
+  ASTUnit ast_unit(clang::tooling::buildASTFromCodeWithArgs(
+      source, CompilerArgsFromCommand(command), report.file));
+  if (!ast_unit) {
+    report.error = "clang failed to build the AST";
+  }
+  return ast_unit;
+}
+
+std::unique_ptr<ProjectIndexer> ProjectIndexer::Create(
+    const std::string& path, std::string& error_message, unsigned threads) {
+  auto database = LoadCompilationDatabase(path, error_message);
+  if (!database) {
+    return nullptr;
+  }
+  return std::make_unique<ProjectIndexer>(std::move(database), threads);
+}
+
+ProjectIndexer::ProjectIndexer(
+    std::unique_ptr<clang::tooling::CompilationDatabase> db, unsigned threads)
+    : database(std::move(db)),
+      commands(database->getAllCompileCommands()),
+      threads(threads) {
+  reports.reserve(commands.size());
+}
+
+ProjectIndexer::~ProjectIndexer() {
+  cancelled.store(true, std::memory_order_relaxed);
+  Wait();
+}
+
+void ProjectIndexer::Start() {
+  thread = std::thread([this] { Run(); });
+}
+
+void ProjectIndexer::Wait() {
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+std::vector<TranslationUnitReport> ProjectIndexer::Reports() const {
+  std::lock_guard<std::mutex> lock(reports_mutex);
+  return reports;
+}
+
+std::optional<CallGraph> ProjectIndexer::TakeResult() {
+  if (!IsFinished()) {
+    return std::nullopt;
+  }
+  std::optional<CallGraph> taken = std::move(result);
+  result.reset();
+  return taken;
+}
+
+std::string ProjectIndexer::DumpFunction(unsigned id, const std::string& usr,
+                                         const std::string& name) const {
+  if (!IsFinished() || id >= node_translation_units.size()) {
+    return "Function not found in the project";
+  }
+  unsigned translation_unit = node_translation_units[id];
+  std::lock_guard<std::mutex> lock(ast_mutex);
+  auto cached = std::find_if(
+      recent_asts.begin(), recent_asts.end(),
+      [&](const auto& entry) { return entry.first == translation_unit; });
+  if (cached != recent_asts.end()) {
+    recent_asts.splice(recent_asts.begin(), recent_asts, cached);
+  } else {
+    TranslationUnitReport report;
+    ASTUnit ast_unit = BuildASTFromCommand(commands[translation_unit], report);
+    if (!ast_unit) {
+      return report.file + ": " + report.error;
+    }
+    recent_asts.emplace_front(translation_unit, std::move(ast_unit));
+    if (recent_asts.size() > AST_CACHE_SIZE) {
+      recent_asts.pop_back();
+    }
+  }
+  return DumpDecl(FindFunctionByUSR(recent_asts.front().second, usr, name));
+}
+
+void ProjectIndexer::Run() {
+  ThreadPool pool(threads);
+  ShardedNodeTable node_table;
+  // Edges and call site files per worker. Only the worker with the
+  // matching index touches its slot.
+  std::vector<CallGraph> partial(pool.Size());
+  auto is_cancelled = [this] {
+    return cancelled.load(std::memory_order_relaxed);
+  };
+
+  for (unsigned translation_unit = 0; translation_unit < commands.size();
+       translation_unit++) {
+    pool.Submit([&, translation_unit](unsigned worker) {
+      // clang can not be interrupted while parsing, so cancelling skips the
+      // units not started yet and stops the extraction of running ones.
+      if (is_cancelled()) {
+        return;
+      }
+      TranslationUnitReport report;
+      auto start = std::chrono::steady_clock::now();
+      ASTUnit ast_unit = BuildASTFromCommand(commands[translation_unit], report);
+      report.parse_ms = MillisecondsSince(start);
+      if (is_cancelled()) {
+        return;
+      }
+
+      if (ast_unit) {
+        start = std::chrono::steady_clock::now();
+        CallGraph call_graph = ExtractCallGraphFromAST(ast_unit, is_cancelled);
+
+        // Indexed like call_graph.nodes, whose entries Merge moves out.
+        std::vector<FunctionDecl*> merged;
+        merged.reserve(call_graph.nodes.size());
+        for (auto& node : call_graph.nodes) {
+          merged.push_back(node_table.Merge(node, translation_unit));
+        }
+        auto& worker_graph = partial[worker];
+        auto files = worker_graph.AddFiles(call_graph.files);
+        for (uint32_t caller = 0; caller < merged.size(); caller++) {
+          for (const auto& edge : call_graph.Callees(caller)) {
+            for (auto call_site : call_graph.CallSites(edge)) {
+              call_site.file = files[call_site.file];
+              worker_graph.edges.push_back(
+                  {merged[caller], merged[edge.callee], call_site});
+            }
+          }
+        }
+        report.extract_ms = MillisecondsSince(start);
+
+        // Partial graphs of TUs with errors are still merged.
+        report.ok = !ast_unit.HasErrors();
+        if (!report.ok) {
+          report.error = "compile errors";
+        }
+      }
+
+      if (!report.ok) {
+        failed++;
+      }
+      {
+        std::lock_guard<std::mutex> lock(reports_mutex);
+        reports.emplace_back(std::move(report));
+      }
+      done++;
+      if (on_progress) {
+        on_progress();
+      }
+    });
+  }
+  pool.Wait();
+  if (is_cancelled()) {
+    return;
+  }
+
+  CallGraph call_graph;
+  call_graph.nodes = node_table.TakeNodes(node_translation_units);
+  for (auto& worker_graph : partial) {
+    auto files = call_graph.AddFiles(worker_graph.files);
+    for (auto edge : worker_graph.edges) {
+      edge.call_site.file = files[edge.call_site.file];
+      call_graph.edges.push_back(edge);
+    }
+    worker_graph = CallGraph();
+  }
+  call_graph.BuildAdjacency();
+  result = std::move(call_graph);
+  finished.store(true, std::memory_order_release);
+  if (on_progress) {
+    on_progress();
+  }
+}
+
+};  // namespace clang_interface
@@ -0,0 +1,134 @@
+#ifndef PROJECT_INDEXER_H
+#define PROJECT_INDEXER_H
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang_interface.h"
+
+namespace clang_interface {
+
+struct TranslationUnitReport {
+  std::string file;
+  double parse_ms = 0;
+  double extract_ms = 0;
+  bool ok = false;
+  std::string error;
+};
+
+// Merges per translation unit call graphs into one graph by USR. The table
+// is split into shards with their own lock, so workers merging different
+// functions rarely wait on each other.
+class ShardedNodeTable {
+ private:
+  static constexpr size_t SHARDS = 64;
+  struct Shard {
+    std::mutex mutex;
+    // USR -> position in nodes and translation_units.
+    std::unordered_map<std::string, size_t> by_usr;
+    CallGraph::NodesList nodes;
+    std::vector<unsigned> translation_units;
+  };
+  std::array<Shard, SHARDS> shards;
+  std::atomic<unsigned> next_id{0};
+
+ public:
+  // Returns the merged node standing for node. Takes ownership of node if
+  // its function has not been seen yet. Otherwise moves node over the merged
+  // one, keeping its ID, when it is the definition and the merged node is
+  // not, and leaves it untouched if not.
+  FunctionDecl* Merge(std::unique_ptr<FunctionDecl>& node,
+                      unsigned translation_unit);
+  // Also fills, by node ID, the translation unit each node was taken from.
+  CallGraph::NodesList TakeNodes(std::vector<unsigned>& translation_units);
+};
+
+// Parses every translation unit of a compilation database on a work
+// stealing thread pool and merges the results into one call graph. Each AST
+// is dropped as soon as its call graph is extracted.
+class ProjectIndexer {
+ private:
+  std::unique_ptr<clang::tooling::CompilationDatabase> database;
+  std::vector<clang::tooling::CompileCommand> commands;
+  unsigned threads;
+
+  mutable std::mutex reports_mutex;
+  std::vector<TranslationUnitReport> reports;
+  std::atomic<size_t> done{0};
+  std::atomic<size_t> failed{0};
+  std::atomic<bool> finished{false};
+  // Set by the destructor, so closing the window does not wait for every
+  // queued translation unit to be parsed.
+  std::atomic<bool> cancelled{false};
+  std::optional<CallGraph> result;
+  std::vector<unsigned> node_translation_units;
+  std::function<void()> on_progress;
+  std::thread thread;
+
+  // ASTs reparsed by DumpFunction, most recently used first, by
+  // translation unit. Dumps of one file tend to come in a row.
+  static constexpr size_t AST_CACHE_SIZE = 4;
+  mutable std::mutex ast_mutex;
+  mutable std::list<std::pair<unsigned, ASTUnit>> recent_asts;
+
+  void Run();
+
+ public:
+  // path is either a compile_commands.json or the directory holding one.
+  static std::unique_ptr<ProjectIndexer> Create(
+      const std::string& path, std::string& error_message,
+      unsigned threads = std::thread::hardware_concurrency());
+  ProjectIndexer(std::unique_ptr<clang::tooling::CompilationDatabase> db,
+                 unsigned threads);
+  ~ProjectIndexer();
+
+  // Called from the indexing threads after every translation unit and once
+  // the result is ready. Has to be set before Start.
+  void SetOnProgress(std::function<void()> callback) {
+    on_progress = std::move(callback);
+  }
+  void Start();
+  void Wait();
+
+  size_t TotalCount() const { return commands.size(); }
+  size_t DoneCount() const { return done.load(std::memory_order_relaxed); }
+  size_t FailedCount() const { return failed.load(std::memory_order_relaxed); }
+  bool IsFinished() const { return finished.load(std::memory_order_acquire); }
+  std::vector<TranslationUnitReport> Reports() const;
+  // Hands out the merged graph once indexing is finished.
+  std::optional<CallGraph> TakeResult();
+  // ASTs are freed right after extraction, so this parses the translation
+  // unit the node came from again, unless it is one of the last few dumped
+  // from. Meant to back an ASTDumpCache::Dumper.
+  std::string DumpFunction(unsigned id, const std::string& usr,
+                           const std::string& name) const;
+};
+
+// file resolved against the directory command runs in.
+std::filesystem::path SourcePath(const clang::tooling::CompileCommand& command,
+                                 const std::string& file);
+// The arguments of command without the compiler, the source file, -c and
+// -o <file>, for buildASTFromCodeWithArgs.
+std::vector<std::string> CompilerArgsFromCommand(
+    const clang::tooling::CompileCommand& command);
+// path is either a compile_commands.json or the directory holding one.
+std::unique_ptr<clang::tooling::CompilationDatabase> LoadCompilationDatabase(
+    const std::string& path, std::string& error_message);
+// Parses the file of command the way the build compiles it. Fills the file
+// name and, on failure, the error of report.
+ASTUnit BuildASTFromCommand(const clang::tooling::CompileCommand& command,
+                            TranslationUnitReport& report);
+
+};  // namespace clang_interface
+
+#endif  // PROJECT_INDEXER_H
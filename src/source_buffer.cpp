@@ -0,0 +1,72 @@
+#include "source_buffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace clang_interface {
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::Map(
+    const std::string& path, std::string& error_message) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error_message = "can not open " + path;
+    return nullptr;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    close(fd);
+    error_message = path + " is not a regular file";
+    return nullptr;
+  }
+  size_t size = file_stat.st_size;
+  if (size == 0) {
+    close(fd);
+    return FromString("");
+  }
+
+  // The file goes over an anonymous mapping one byte longer, rounded up to
+  // whole pages. The kernel zero fills the file's last page past its end,
+  // and a file that ends on a page boundary gets the NUL from the zero page
+  // after it.
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t mapped_size = (size / page + 1) * page;
+  void* reserved = mmap(nullptr, mapped_size, PROT_READ,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* mapping =
+      reserved == MAP_FAILED
+          ? MAP_FAILED
+          : mmap(reserved, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    if (reserved != MAP_FAILED) munmap(reserved, mapped_size);
+    error_message = "can not map " + path;
+    return nullptr;
+  }
+  // The editor and the lexer both read it front to back.
+  madvise(mapping, size, MADV_SEQUENTIAL);
+
+  std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+  buffer->data = static_cast<const char*>(mapping);
+  buffer->size = size;
+  buffer->mapped_size = mapped_size;
+  return buffer;
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::FromString(
+    std::string text) {
+  std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+  buffer->owned = std::move(text);
+  buffer->data = buffer->owned.c_str();
+  buffer->size = buffer->owned.size();
+  return buffer;
+}
+
+SourceBuffer::~SourceBuffer() {
+  if (mapped_size) {
+    munmap(const_cast<char*>(data), mapped_size);
+  }
+}
+
+};  // namespace clang_interface
@@ -0,0 +1,40 @@
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace clang_interface {
+
+// Read-only source text, shared by the editor and the parser. Opened files
+// are mapped instead of read, edited text owns a string. The text is always
+// followed by a NUL byte, which clang's lexer needs, so it is handed to
+// clang without a copy.
+//
+// Like clang's own file buffers, a mapped file that another process
+// truncates in place faults when read past the new end. Most editors and
+// git replace files instead.
+class SourceBuffer {
+ private:
+  const char* data{nullptr};
+  size_t size{0};
+  size_t mapped_size{0};
+  std::string owned;
+
+  SourceBuffer() = default;
+
+ public:
+  static std::shared_ptr<const SourceBuffer> Map(const std::string& path,
+                                                 std::string& error_message);
+  static std::shared_ptr<const SourceBuffer> FromString(std::string text);
+  ~SourceBuffer();
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+  std::string_view Text() const { return {data, size}; }
+};
+
+};  // namespace clang_interface
+
+#endif  // SOURCE_BUFFER_H
@@ -0,0 +1,63 @@
+#include "spatial_index.hpp"
+
+namespace gui {
+
+void SpatialIndex::clear() {
+  levels.clear();
+  items.clear();
+  bounds.clear();
+  seen.clear();
+}
+
+void SpatialIndex::build(std::vector<ImRect> item_bounds, float cell_size) {
+  clear();
+  bounds = std::move(item_bounds);
+  seen.assign(bounds.size(), 0);
+  query_stamp = 0;
+
+  struct Entry {
+    uint32_t level;
+    uint64_t key;
+    uint32_t item;
+  };
+  std::vector<Entry> entries;
+  entries.reserve(bounds.size());
+  for (uint32_t item = 0; item < bounds.size(); item++) {
+    const ImRect& rect = bounds[item];
+    float extent = std::max(rect.GetWidth(), rect.GetHeight());
+    uint32_t level = 0;
+    while (cell_size * float(1u << level) < extent && level < 30) level++;
+    if (levels.size() <= level) levels.resize(level + 1);
+
+    float size = cell_size * float(1u << level);
+    int x0 = int(std::floor(rect.Min.x / size));
+    int y0 = int(std::floor(rect.Min.y / size));
+    int x1 = int(std::floor(rect.Max.x / size));
+    int y1 = int(std::floor(rect.Max.y / size));
+    for (int x = x0; x <= x1; x++)
+      for (int y = y0; y <= y1; y++)
+        entries.push_back({level, cell_key(x, y), item});
+  }
+  for (uint32_t level = 0; level < levels.size(); level++)
+    levels[level].cell_size = cell_size * float(1u << level);
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.level != b.level ? a.level < b.level : a.key < b.key;
+            });
+  items.reserve(entries.size());
+  std::pair<uint32_t, uint32_t>* cell = nullptr;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const Entry& entry = entries[i];
+    if (i == 0 || entries[i - 1].level != entry.level ||
+        entries[i - 1].key != entry.key) {
+      cell = &levels[entry.level]
+                  .cells.emplace(entry.key, std::make_pair(items.size(), 0))
+                  .first->second;
+    }
+    items.push_back(entry.item);
+    cell->second = items.size();
+  }
+}
+
+}  // namespace gui
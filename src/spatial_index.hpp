@@ -0,0 +1,78 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "imgui.h"
+#include "imgui_internal.h"
+
+namespace gui {
+
+// Hierarchical uniform grid over rectangles. Level l has cells of
+// cell_size * 2^l, and every item goes to the finest level where it
+// touches at most 2x2 cells. Long edges therefore land in a few coarse
+// cells instead of thousands of fine ones. A query only visits the cells
+// under the queried area on each level.
+class SpatialIndex {
+ private:
+  struct Level {
+    float cell_size;
+    // Cell key -> [first, last) into items.
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> cells;
+  };
+
+  std::vector<Level> levels;
+  std::vector<uint32_t> items;
+  std::vector<ImRect> bounds;
+  // Items seen by the current query, so items spanning several cells are
+  // reported once.
+  std::vector<uint32_t> seen;
+  uint32_t query_stamp = 0;
+
+  static uint64_t cell_key(int x, int y) {
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+  }
+
+ public:
+  // Item ids are positions in item_bounds.
+  void build(std::vector<ImRect> item_bounds, float cell_size);
+  void clear();
+  size_t size() const { return bounds.size(); }
+  const ImRect& item_bounds(uint32_t item) const { return bounds[item]; }
+
+  // Calls visit(id) once for every item whose bounds overlap area.
+  template <typename Visit>
+  void query(const ImRect& area, Visit&& visit) {
+    if (++query_stamp == 0) {
+      std::fill(seen.begin(), seen.end(), 0);
+      query_stamp = 1;
+    }
+    for (const auto& level : levels) {
+      if (level.cells.empty()) continue;
+      int x0 = int(std::floor(area.Min.x / level.cell_size));
+      int y0 = int(std::floor(area.Min.y / level.cell_size));
+      int x1 = int(std::floor(area.Max.x / level.cell_size));
+      int y1 = int(std::floor(area.Max.y / level.cell_size));
+      for (int x = x0; x <= x1; x++) {
+        for (int y = y0; y <= y1; y++) {
+          auto cell = level.cells.find(cell_key(x, y));
+          if (cell == level.cells.end()) continue;
+          for (uint32_t i = cell->second.first; i < cell->second.second; i++) {
+            uint32_t item = items[i];
+            if (seen[item] == query_stamp) continue;
+            seen[item] = query_stamp;
+            if (bounds[item].Overlaps(area)) visit(item);
+          }
+        }
+      }
+    }
+  }
+};
+
+}  // namespace gui
+
+#endif
@@ -0,0 +1,90 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+  threads = std::max(1u, threads);
+  for (unsigned i = 0; i < threads; i++) {
+    queues.emplace_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back([this, i] { Run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  work_available.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(Task task) {
+  auto& queue = *queues[next_queue++ % queues.size()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued++;
+    unfinished++;
+  }
+  work_available.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  all_done.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool ThreadPool::TryPop(unsigned worker, Task& task) {
+  for (unsigned i = 0; i < queues.size(); i++) {
+    auto& queue = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::Run(unsigned worker) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      work_available.wait(lock, [this] { return stop || queued > 0; });
+      if (queued == 0) {
+        return;
+      }
+      // Claim one task before searching, so idle workers go back to sleep
+      // instead of spinning over queues somebody else is draining.
+      queued--;
+    }
+
+    Task task;
+    while (!TryPop(worker, task)) {
+      // The claimed task was pushed to its queue before queued was bumped,
+      // so it is there; another claimant may just have popped ours first.
+      std::this_thread::yield();
+    }
+    task(worker);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--unfinished == 0) {
+      all_done.notify_all();
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool where every worker owns a task queue. Workers take new
+// work from the back of their own queue and, once it is empty, steal from
+// the front of the others, so a few slow tasks do not leave cores idle.
+class ThreadPool {
+ public:
+  // Tasks get the index of the worker running them, which lets callers keep
+  // per-worker state without locking.
+  using Task = std::function<void(unsigned worker)>;
+
+  explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Submit(Task task);
+  // Blocks until every submitted task has finished.
+  void Wait();
+  unsigned Size() const { return workers.size(); }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<unsigned> next_queue{0};
+
+  std::mutex mutex;
+  std::condition_variable work_available;
+  std::condition_variable all_done;
+  size_t queued = 0;
+  size_t unfinished = 0;
+  bool stop = false;
+
+  bool TryPop(unsigned worker, Task& task);
+  void Run(unsigned worker);
+};
+
+#endif  // THREAD_POOL_H